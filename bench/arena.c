@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <time.h>
+#include "../blox_arena.h"
+
+/*
+ Push-heavy "request handler" workload (along the lines of demo.c and
+ example.c) run against the default `realloc` heap and against an arena
+ that is reset at the end of every request
+*/
+
+typedef struct {
+  blox tag;
+  int id;
+} info;
+
+static const char* tags[] = {"First", "Second", "Third", "Fourth"};
+
+size_t handle_request(int seed) {
+  size_t checksum = 0;
+  blox records = {0};
+  for (int list = 0; list < 24; ++list) {
+    blox values = {0};
+    for (int index = 0; index < 64; ++index)
+      blox_push(int, values, seed + index);
+    blox_append(int, values, values);
+    checksum += blox_back(int, values);
+    blox_free(values);
+    info fyi = {{0}, list};
+    blox_append_string(char, fyi.tag, tags[list & 3]);
+    blox_append_string(char, fyi.tag, tags[(list + seed) & 3]);
+    blox_push(info, records, fyi);
+  }
+  for (size_t index = 0; index < records.length; ++index) {
+    info* fyi = blox_index(info, records, index);
+    checksum += fyi->tag.length;
+    blox_free(fyi->tag);
+  }
+  blox_free(records);
+  return checksum;
+}
+
+double run(blox_arena* arena, int requests, size_t* checksum) {
+  clock_t start = clock();
+  for (int request = 0; request < requests; ++request) {
+    blox_heap* saved = NULL;
+    if (arena)
+      saved = blox_heap_scope(blox_arena_heap(arena));
+    *checksum += handle_request(request);
+    if (arena) {
+      blox_heap_scope(saved);
+      blox_arena_reset(arena);
+    }
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv) {
+  int requests = argc > 1 ? atoi(argv[1]) : 20000;
+  /* Each request performs 24 * (64 pushes + 1 append + 2 appends) + 24 */
+  double operations = (double)requests * 24 * 68;
+  size_t realloc_sum = 0, arena_sum = 0;
+  blox_arena arena;
+  blox_arena_init(&arena, 1 << 16);
+  double heap_time = run(NULL, requests, &realloc_sum);
+  double arena_time = run(&arena, requests, &arena_sum);
+  blox_arena_free(&arena);
+  if (realloc_sum != arena_sum)
+    puts("Checksum mismatch!");
+  printf("operations: %.0f\n", operations);
+  printf("realloc: %.3f s (%.1f ns/op)\n", heap_time,
+         heap_time * 1e9 / operations);
+  printf("arena:   %.3f s (%.1f ns/op)\n", arena_time,
+         arena_time * 1e9 / operations);
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <time.h>
+#include "../blox_hash.h"
+#include "../blox_sort.h"
+
+/*
+ Deduplicates and looks up 10M random 64-bit keys (a third of them repeated)
+ with a hash set and with sorting + blox_search
+*/
+
+typedef unsigned long long number;
+
+BLOX_DEFINE_HASH_SET(key_set, number, blox_hash_scalar, blox_equal_to)
+BLOX_DEFINE_SORT(key_sort, number, blox_less_than)
+
+int compare_key(const number* lhs, const number* rhs) {
+  return (*lhs > *rhs) - (*lhs < *rhs);
+}
+
+unsigned long long seed = 88172645463325252ULL;
+
+number random_number(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+void report(const char* name, clock_t start, size_t found) {
+  printf("%-28s %8.3f s  (%zu)\n", name,
+         (double)(clock() - start) / CLOCKS_PER_SEC, found);
+}
+
+int main(int argc, char** argv) {
+  size_t keys = argc > 1 ? (size_t)atol(argv[1]) : 10000000;
+  blox input = blox_make(number, keys);
+  for (size_t index = 0; index < keys; ++index)
+    blox_set(number, input, index, random_number() % keys);
+  printf("%zu keys\n", keys);
+  unsigned long long probes = seed;
+
+  blox_hash set = {{0}};
+  clock_t start = clock();
+  size_t unique = 0;
+  for (size_t index = 0; index < keys; ++index)
+    unique += key_set_insert(&set, blox_get(number, input, index));
+  report("hash set insert", start, unique);
+  start = clock();
+  seed = probes;
+  size_t found = 0;
+  for (size_t index = 0; index < keys; ++index)
+    found += key_set_contains(&set, random_number() % keys);
+  report("hash set lookup", start, found);
+  blox_hash_free(set);
+
+  start = clock();
+  key_set_reserve(&set, keys);
+  unique = 0;
+  for (size_t index = 0; index < keys; ++index)
+    unique += key_set_insert(&set, blox_get(number, input, index));
+  report("hash set insert (reserved)", start, unique);
+  blox_hash_free(set);
+
+  blox sorted = blox_clone(number, input);
+  start = clock();
+  key_sort(sorted);
+  unique = 0;
+  for (size_t index = 0; index < sorted.length; ++index) {
+    number value = blox_get(number, sorted, index);
+    if (unique == 0 || value != blox_get(number, sorted, unique - 1))
+      blox_set(number, sorted, unique++, value);
+  }
+  blox_resize(number, sorted, unique);
+  report("introsort + unique", start, unique);
+  start = clock();
+  seed = probes;
+  found = 0;
+  for (size_t index = 0; index < keys; ++index) {
+    number probe = random_number() % keys;
+    found += blox_search(number, sorted, probe, compare_key) != NULL;
+  }
+  report("blox_search lookup", start, found);
+  blox_free(sorted);
+  blox_free(input);
+  return 0;
+}
@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <time.h>
+#include "../blox.h"
+
+/*
+ Times the hot blox operations for element sizes of 1 to 64 bytes and
+ lengths from 10 up to a limit (first argument, 1M by default; lengths
+ whose data would exceed the second argument in MB, 512 by default, are
+ skipped), next to a hand-rolled C array ("c" rows). Prints CSV:
+
+   library,operation,width,length,ns_per_op,bytes_per_op,allocations
+
+ An op is one element for push, append, find, sort, clone, slice, string
+ and compare, and one call for insert (of one element in the middle),
+ splice (of four), unshift, erase, shift and search. bytes_per_op is the
+ number of bytes requested from the heap per op, allocations the number
+ of heap calls per repetition.
+
+ bench/vector.cpp writes std::vector rows for every operation. Only push,
+ append, insert, erase, find and clone have "c" rows; splice, unshift,
+ shift, sort, search, slice, string and compare are compared against
+ std::vector alone.
+*/
+
+static size_t allocations = 0;
+static size_t allocated = 0;
+
+void* counting_allocate(void* context, size_t size, size_t alignment) {
+  (void)context;
+  (void)alignment;
+  ++allocations;
+  allocated += size;
+  return malloc(size);
+}
+
+void* counting_reallocate(void* context,
+                          void* data,
+                          size_t size,
+                          size_t request,
+                          size_t alignment) {
+  (void)context;
+  (void)size;
+  (void)alignment;
+  ++allocations;
+  allocated += request;
+  return realloc(data, request);
+}
+
+void counting_release(void* context, void* data) {
+  (void)context;
+  free(data);
+}
+
+static blox_heap counting = {counting_allocate, counting_reallocate,
+                             counting_release, NULL, 0, NULL};
+
+/*
+ Hand-rolled baseline, growing by doubling like the default heap
+*/
+void* c_grow(void* data, size_t* capacity, size_t request, size_t width) {
+  if (request <= *capacity)
+    return data;
+  size_t room = *capacity ? *capacity : 1;
+  while (room < request)
+    room *= 2;
+  ++allocations;
+  allocated += room * width;
+  *capacity = room;
+  return realloc(data, room * width);
+}
+
+double now(void) {
+  struct timespec spec;
+  timespec_get(&spec, TIME_UTC);
+  return spec.tv_sec * 1e9 + spec.tv_nsec;
+}
+
+typedef struct {
+  double elapsed;
+  double started;
+  size_t allocations;
+  size_t allocated;
+} probe;
+
+probe probe_start(void) {
+  probe timer = {0, now(), allocations, allocated};
+  return timer;
+}
+
+#define probe_pause(timer) ((timer).elapsed += now() - (timer).started)
+
+#define probe_resume(timer) ((timer).started = now())
+
+void report(const char* library,
+            const char* operation,
+            size_t width,
+            size_t length,
+            probe timer,
+            size_t ops,
+            size_t repeat) {
+  printf("%s,%s,%zu,%zu,%.3f,%.3f,%.1f\n", library, operation, width, length,
+         timer.elapsed / ops, (double)(allocated - timer.allocated) / ops,
+         (double)(allocations - timer.allocations) / repeat);
+}
+
+/* Keeps results alive so the work isn't optimized away */
+static volatile size_t sink;
+
+uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 31)) * 0x7FB5D329728EA185ULL;
+  value = (value ^ (value >> 27)) * 0x81DADEF4BC2DD44DULL;
+  return value ^ (value >> 33);
+}
+
+typedef struct {
+  uint64_t words[2];
+} bytes16;
+
+typedef struct {
+  uint64_t words[4];
+} bytes32;
+
+typedef struct {
+  uint64_t words[8];
+} bytes64;
+
+#define find_scalar(TYPE, buffer, key, compare) \
+  blox_find_value(TYPE, buffer, key)
+
+#define find_struct(TYPE, buffer, key, compare) \
+  blox_find(TYPE, buffer, key, compare)
+
+#define compare_scalar(lhs, rhs) ((*(lhs) > *(rhs)) - (*(lhs) < *(rhs)))
+
+#define compare_memory(lhs, rhs) memcmp(lhs, rhs, sizeof(*(lhs)))
+
+#define equal_scalar(lhs, rhs) ((lhs) == (rhs))
+
+#define equal_memory(lhs, rhs) (memcmp(&(lhs), &(rhs), sizeof(lhs)) == 0)
+
+/*
+ Stamps out `bench_NAME(length)`, running every operation on containers
+ of TYPE (COMPARE orders two TYPE*, EQUAL compares two TYPE values)
+*/
+#define BENCH_SUITE(NAME, TYPE, FIND, COMPARE, EQUAL)                          \
+  int compare_##NAME(const TYPE* lhs, const TYPE* rhs) {                       \
+    return COMPARE(lhs, rhs);                                                  \
+  }                                                                            \
+                                                                               \
+  TYPE value_##NAME(size_t index) {                                            \
+    TYPE value;                                                                \
+    uint64_t bits = mix(index + 1) | 0x0101010101010101ULL;                    \
+    memset(&value, 0x5A, sizeof(TYPE));                                        \
+    memcpy(&value, &bits, sizeof(TYPE) < 8 ? sizeof(TYPE) : 8);                \
+    return value;                                                              \
+  }                                                                            \
+                                                                               \
+  void bench_##NAME(size_t length) {                                           \
+    size_t width = sizeof(TYPE);                                               \
+    size_t repeat = (1 << 20) / length ? (1 << 20) / length : 1;               \
+    size_t calls = length < 256 ? length : 256;                                \
+    size_t rounds = ((size_t)1 << 22) / (calls * length);                      \
+    rounds = rounds > 1024 ? 1024 : rounds ? rounds : 1;                       \
+    blox source = blox_make(TYPE, length);                                     \
+    for (size_t index = 0; index < length; ++index)                            \
+      blox_set(TYPE, source, index, value_##NAME(index));                      \
+    TYPE last = blox_back(TYPE, source);                                       \
+    probe timer;                                                               \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      blox pushed = {0};                                                       \
+      for (size_t index = 0; index < length; ++index)                          \
+        blox_push(TYPE, pushed, blox_get(TYPE, source, index));                \
+      sink += pushed.length;                                                   \
+      blox_free(pushed);                                                       \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "push", width, length, timer, length * repeat, repeat);     \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      TYPE* pushed = NULL;                                                     \
+      size_t capacity = 0;                                                     \
+      for (size_t index = 0; index < length; ++index) {                        \
+        pushed = (TYPE*)c_grow(pushed, &capacity, index + 1, width);           \
+        pushed[index] = blox_get(TYPE, source, index);                         \
+      }                                                                        \
+      sink += capacity;                                                        \
+      free(pushed);                                                            \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "push", width, length, timer, length * repeat, repeat);        \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      blox appended = {0};                                                     \
+      for (size_t index = 0; index < length; index += 64) {                    \
+        size_t amount = length - index < 64 ? length - index : 64;             \
+        blox_append(TYPE, appended,                                            \
+                    blox_use_view(TYPE, source, index, amount));               \
+      }                                                                        \
+      sink += appended.length;                                                 \
+      blox_free(appended);                                                     \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "append", width, length, timer, length * repeat, repeat);   \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      TYPE* appended = NULL;                                                   \
+      size_t capacity = 0;                                                     \
+      for (size_t index = 0; index < length; index += 64) {                    \
+        size_t amount = length - index < 64 ? length - index : 64;             \
+        appended = (TYPE*)c_grow(appended, &capacity, index + amount, width);  \
+        memcpy(appended + index, blox_index(TYPE, source, index),              \
+               amount * width);                                                \
+      }                                                                        \
+      sink += capacity;                                                        \
+      free(appended);                                                          \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "append", width, length, timer, length * repeat, repeat);      \
+                                                                               \
+    blox work = {0};                                                           \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, work, source);                                           \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < calls; ++call)                              \
+        blox_splice_array(TYPE, work, work.length / 2, &last, 1);              \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "insert", width, length, timer, calls * rounds, rounds);    \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      size_t capacity = length;                                                \
+      size_t used = length;                                                    \
+      TYPE* array = (TYPE*)malloc(length * width);                             \
+      memcpy(array, source.data, length * width);                              \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < calls; ++call) {                            \
+        array = (TYPE*)c_grow(array, &capacity, used + 1, width);              \
+        memmove(array + used / 2 + 1, array + used / 2,                        \
+                (used - used / 2) * width);                                    \
+        array[used / 2] = last;                                                \
+        ++used;                                                                \
+      }                                                                        \
+      sink += used;                                                            \
+      free(array);                                                             \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "insert", width, length, timer, calls * rounds, rounds);       \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, work, source);                                           \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < calls; ++call)                              \
+        blox_splice(TYPE, work, work.length / 2,                               \
+                    blox_use_view(TYPE, source, 0, length < 4 ? length : 4));  \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "splice", width, length, timer, calls * rounds, rounds);    \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, work, source);                                           \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < calls; ++call)                              \
+        blox_unshift(TYPE, work, last);                                        \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "unshift", width, length, timer, calls * rounds, rounds);   \
+                                                                               \
+    size_t removals = calls < length / 2 ? calls : length / 2;                 \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, work, source);                                           \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < removals; ++call)                           \
+        blox_erase(TYPE, work, work.length / 2);                               \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "erase", width, length, timer, removals * rounds, rounds);  \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      size_t used = length;                                                    \
+      TYPE* array = (TYPE*)malloc(length * width);                             \
+      memcpy(array, source.data, length * width);                              \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < removals; ++call, --used)                   \
+        memmove(array + used / 2, array + used / 2 + 1,                        \
+                (used - used / 2 - 1) * width);                                \
+      sink += used;                                                            \
+      free(array);                                                             \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "erase", width, length, timer, removals * rounds, rounds);     \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < rounds; ++round) {                          \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, work, source);                                           \
+      probe_resume(timer);                                                     \
+      for (size_t call = 0; call < removals; ++call)                           \
+        blox_shift(TYPE, work);                                                \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "shift", width, length, timer, removals * rounds, rounds);  \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round)                            \
+      sink += FIND(TYPE, source, last, compare_##NAME) != NULL;                \
+    probe_pause(timer);                                                        \
+    report("blox", "find", width, length, timer, length * repeat, repeat);     \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      const TYPE* array = blox_data(TYPE, source);                             \
+      size_t index = 0;                                                        \
+      while (index < length && !EQUAL(array[index], last))                     \
+        ++index;                                                               \
+      sink += index;                                                           \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "find", width, length, timer, length * repeat, repeat);        \
+                                                                               \
+    blox sorted = blox_clone(TYPE, source);                                    \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < (repeat > 16 ? 16 : repeat); ++round) {     \
+      probe_pause(timer);                                                      \
+      blox_copy(TYPE, sorted, source);                                         \
+      probe_resume(timer);                                                     \
+      blox_sort(TYPE, sorted, compare_##NAME);                                 \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "sort", width, length, timer,                               \
+           length * (repeat > 16 ? 16 : repeat), repeat > 16 ? 16 : repeat);   \
+                                                                               \
+    size_t lookups = calls * rounds;                                           \
+    timer = probe_start();                                                     \
+    for (size_t lookup = 0; lookup < lookups; ++lookup) {                      \
+      TYPE key = blox_get(TYPE, source, mix(lookup) % length);                 \
+      sink += blox_search(TYPE, sorted, key, compare_##NAME) != NULL;          \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "search", width, length, timer, lookups, 1);                \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      blox copy = blox_clone(TYPE, source);                                    \
+      sink += copy.length;                                                     \
+      blox_free(copy);                                                         \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "clone", width, length, timer, length * repeat, repeat);    \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      ++allocations;                                                           \
+      allocated += length * width;                                             \
+      TYPE* copy = (TYPE*)malloc(length * width);                              \
+      memcpy(copy, source.data, length * width);                               \
+      sink += memcmp(copy, &last, width) == 0;                                 \
+      free(copy);                                                              \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("c", "clone", width, length, timer, length * repeat, repeat);       \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round) {                          \
+      blox half = blox_slice(TYPE, source, length / 4, length / 2 + 1);        \
+      sink += half.length;                                                     \
+      blox_free(half);                                                         \
+    }                                                                          \
+    probe_pause(timer);                                                        \
+    report("blox", "slice", width, length, timer, (length / 2 + 1) * repeat,   \
+           repeat);                                                            \
+                                                                               \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round)                            \
+      sink += blox_string_length(TYPE, source.data);                           \
+    probe_pause(timer);                                                        \
+    report("blox", "string", width, length, timer, length * repeat, repeat);   \
+                                                                               \
+    blox twin = blox_clone(TYPE, source);                                      \
+    timer = probe_start();                                                     \
+    for (size_t round = 0; round < repeat; ++round)                            \
+      sink += blox_equal(TYPE, source, twin);                                  \
+    probe_pause(timer);                                                        \
+    report("blox", "compare", width, length, timer, length * repeat, repeat);  \
+                                                                               \
+    blox_free(twin);                                                           \
+    blox_free(sorted);                                                         \
+    blox_free(work);                                                           \
+    blox_free(source);                                                         \
+  }
+
+BENCH_SUITE(u8, uint8_t, find_scalar, compare_scalar, equal_scalar)
+BENCH_SUITE(u16, uint16_t, find_scalar, compare_scalar, equal_scalar)
+BENCH_SUITE(u32, uint32_t, find_scalar, compare_scalar, equal_scalar)
+BENCH_SUITE(u64, uint64_t, find_scalar, compare_scalar, equal_scalar)
+BENCH_SUITE(b16, bytes16, find_struct, compare_memory, equal_memory)
+BENCH_SUITE(b32, bytes32, find_struct, compare_memory, equal_memory)
+BENCH_SUITE(b64, bytes64, find_struct, compare_memory, equal_memory)
+
+typedef void (*bench_suite)(size_t length);
+
+int main(int argc, char** argv) {
+  size_t limit = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+  size_t budget = (argc > 2 ? (size_t)atol(argv[2]) : 512) << 20;
+  bench_suite suites[] = {bench_u8,  bench_u16, bench_u32, bench_u64,
+                          bench_b16, bench_b32, bench_b64};
+  size_t widths[] = {1, 2, 4, 8, 16, 32, 64};
+  blox_heap_scope(&counting);
+  puts("library,operation,width,length,ns_per_op,bytes_per_op,allocations");
+  for (size_t suite = 0; suite < sizeof(widths) / sizeof(*widths); ++suite)
+    for (size_t length = 10; length <= limit; length *= 10)
+      if (length * widths[suite] <= budget) {
+        suites[suite](length);
+        fflush(stdout);
+      }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <time.h>
+#include "../blox_sort.h"
+
+/*
+ Sorts 10M ints and 1M info-like structs with blox_sort (qsort) and with
+ the specialized sorts from blox_sort.h
+*/
+
+typedef struct {
+  int key;
+  int order;
+  blox tag;
+} info;
+
+int compare_int(const int* lhs, const int* rhs) {
+  return (*lhs > *rhs) - (*lhs < *rhs);
+}
+
+int compare_info(const info* lhs, const info* rhs) {
+  return (lhs->key > rhs->key) - (lhs->key < rhs->key);
+}
+
+#define info_less(lhs, rhs) ((lhs)->key < (rhs)->key)
+
+BLOX_DEFINE_SORT(int_sort, int, blox_less_than)
+BLOX_DEFINE_SORT(info_sort, info, info_less)
+
+unsigned long long seed = 88172645463325252ULL;
+
+unsigned random_number(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (unsigned)seed;
+}
+
+int sorted_ints(blox buffer) {
+  for (size_t index = 1; index < buffer.length; ++index)
+    if (blox_get(int, buffer, index - 1) > blox_get(int, buffer, index))
+      return 0;
+  return 1;
+}
+
+int stable_infos(blox buffer) {
+  for (size_t index = 1; index < buffer.length; ++index) {
+    info* lhs = blox_index(info, buffer, index - 1);
+    info* rhs = lhs + 1;
+    if (lhs->key > rhs->key || (lhs->key == rhs->key && lhs->order > rhs->order))
+      return 0;
+  }
+  return 1;
+}
+
+void report(const char* name, clock_t start, int valid) {
+  printf("%-28s %8.3f s%s\n", name, (double)(clock() - start) / CLOCKS_PER_SEC,
+         valid ? "" : "  (WRONG ORDER)");
+}
+
+int main(int argc, char** argv) {
+  size_t ints = argc > 1 ? (size_t)atol(argv[1]) : 10000000;
+  size_t infos = argc > 2 ? (size_t)atol(argv[2]) : 1000000;
+  blox input = blox_make(int, ints);
+  for (size_t index = 0; index < ints; ++index)
+    blox_set(int, input, index, (int)random_number());
+
+  printf("%zu ints\n", ints);
+  blox work = blox_clone(int, input);
+  clock_t start = clock();
+  blox_sort(int, work, compare_int);
+  report("blox_sort (qsort)", start, sorted_ints(work));
+  blox_copy(int, work, input);
+  start = clock();
+  int_sort(work);
+  report("introsort", start, sorted_ints(work));
+  blox_copy(int, work, input);
+  start = clock();
+  int_sort_stable(work);
+  report("stable merge sort", start, sorted_ints(work));
+  blox_copy(int, work, input);
+  start = clock();
+  blox_radix_sort(int, work);
+  report("radix sort", start, sorted_ints(work));
+  blox_free(work);
+  blox_free(input);
+
+  printf("%zu structs\n", infos);
+  input = blox_make(info, infos);
+  for (size_t index = 0; index < infos; ++index) {
+    info* fyi = blox_index(info, input, index);
+    fyi->key = (int)(random_number() % 1000);
+    fyi->order = (int)index;
+  }
+  work = blox_clone(info, input);
+  start = clock();
+  blox_sort(info, work, compare_info);
+  report("blox_sort (qsort)", start, 1);
+  blox_copy(info, work, input);
+  start = clock();
+  info_sort(work);
+  report("introsort", start, 1);
+  blox_copy(info, work, input);
+  start = clock();
+  info_sort_stable(work);
+  report("stable merge sort", start, stable_infos(work));
+  blox_copy(info, work, input);
+  start = clock();
+  blox_radix_sort_by(info, work, int, key);
+  report("radix sort by key", start, stable_infos(work));
+  blox_free(work);
+  blox_free(input);
+  return 0;
+}
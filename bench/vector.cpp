@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+/*
+ Not used here: the headers are included so that building this file checks
+ that they all compile as C++
+*/
+#include "../blox.h"
+#include "../blox_aligned.h"
+#include "../blox_arena.h"
+#include "../blox_bits.h"
+#include "../blox_concurrent.h"
+#include "../blox_deque.h"
+#include "../blox_gap.h"
+#include "../blox_hash.h"
+#include "../blox_io.h"
+#include "../blox_mmap.h"
+#include "../blox_parallel.h"
+#include "../blox_shared.h"
+#include "../blox_small.h"
+#include "../blox_soa.h"
+#include "../blox_sort.h"
+
+/*
+ std::vector counterpart of bench/ops.c: same operations, element sizes,
+ lengths, arguments and CSV columns (library "std::vector")
+*/
+
+static size_t allocations = 0;
+static size_t allocated = 0;
+
+template <typename T>
+struct counting {
+  typedef T value_type;
+  counting() {}
+  template <typename U>
+  counting(const counting<U>&) {}
+  T* allocate(size_t count) {
+    ++allocations;
+    allocated += count * sizeof(T);
+    return static_cast<T*>(malloc(count * sizeof(T)));
+  }
+  void deallocate(T* data, size_t) { free(data); }
+};
+
+template <typename T, typename U>
+bool operator==(const counting<T>&, const counting<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const counting<T>&, const counting<U>&) {
+  return false;
+}
+
+double now() {
+  timespec spec;
+  timespec_get(&spec, TIME_UTC);
+  return spec.tv_sec * 1e9 + spec.tv_nsec;
+}
+
+struct probe {
+  double elapsed;
+  double started;
+  size_t allocations;
+  size_t allocated;
+  probe() : elapsed(0), started(now()), allocations(::allocations),
+            allocated(::allocated) {}
+  void pause() { elapsed += now() - started; }
+  void resume() { started = now(); }
+};
+
+void report(const char* operation,
+            size_t width,
+            size_t length,
+            const probe& timer,
+            size_t ops,
+            size_t repeat) {
+  printf("std::vector,%s,%zu,%zu,%.3f,%.3f,%.1f\n", operation, width, length,
+         timer.elapsed / ops, double(allocated - timer.allocated) / ops,
+         double(allocations - timer.allocations) / repeat);
+}
+
+static volatile size_t sink;
+
+uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 31)) * 0x7FB5D329728EA185ULL;
+  value = (value ^ (value >> 27)) * 0x81DADEF4BC2DD44DULL;
+  return value ^ (value >> 33);
+}
+
+template <size_t N>
+struct bytes {
+  uint64_t words[N / 8];
+  bool operator==(const bytes& other) const {
+    return memcmp(words, other.words, N) == 0;
+  }
+  bool operator<(const bytes& other) const {
+    return memcmp(words, other.words, N) < 0;
+  }
+};
+
+template <typename T>
+T value(size_t index) {
+  T result;
+  uint64_t bits = mix(index + 1) | 0x0101010101010101ULL;
+  memset(&result, 0x5A, sizeof(T));
+  memcpy(&result, &bits, sizeof(T) < 8 ? sizeof(T) : 8);
+  return result;
+}
+
+template <typename T>
+void bench(size_t length) {
+  typedef std::vector<T, counting<T> > vector;
+  size_t width = sizeof(T);
+  size_t repeat = (1 << 20) / length ? (1 << 20) / length : 1;
+  size_t calls = length < 256 ? length : 256;
+  size_t rounds = (size_t(1) << 22) / (calls * length);
+  rounds = rounds > 1024 ? 1024 : rounds ? rounds : 1;
+  vector source(length);
+  for (size_t index = 0; index < length; ++index)
+    source[index] = value<T>(index);
+  T last = source.back();
+  T zero = T();
+
+  {
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round) {
+      vector pushed;
+      for (size_t index = 0; index < length; ++index)
+        pushed.push_back(source[index]);
+      sink += pushed.size();
+    }
+    timer.pause();
+    report("push", width, length, timer, length * repeat, repeat);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round) {
+      vector appended;
+      for (size_t index = 0; index < length; index += 64) {
+        size_t amount = length - index < 64 ? length - index : 64;
+        appended.insert(appended.end(), source.begin() + index,
+                        source.begin() + index + amount);
+      }
+      sink += appended.size();
+    }
+    timer.pause();
+    report("append", width, length, timer, length * repeat, repeat);
+  }
+  vector work;
+  {
+    probe timer;
+    for (size_t round = 0; round < rounds; ++round) {
+      timer.pause();
+      work = source;
+      timer.resume();
+      for (size_t call = 0; call < calls; ++call)
+        work.insert(work.begin() + work.size() / 2, last);
+    }
+    timer.pause();
+    report("insert", width, length, timer, calls * rounds, rounds);
+  }
+  {
+    probe timer;
+    size_t amount = length < 4 ? length : 4;
+    for (size_t round = 0; round < rounds; ++round) {
+      timer.pause();
+      work = source;
+      timer.resume();
+      for (size_t call = 0; call < calls; ++call)
+        work.insert(work.begin() + work.size() / 2, source.begin(),
+                    source.begin() + amount);
+    }
+    timer.pause();
+    report("splice", width, length, timer, calls * rounds, rounds);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < rounds; ++round) {
+      timer.pause();
+      work = source;
+      timer.resume();
+      for (size_t call = 0; call < calls; ++call)
+        work.insert(work.begin(), last);
+    }
+    timer.pause();
+    report("unshift", width, length, timer, calls * rounds, rounds);
+  }
+  size_t removals = calls < length / 2 ? calls : length / 2;
+  {
+    probe timer;
+    for (size_t round = 0; round < rounds; ++round) {
+      timer.pause();
+      work = source;
+      timer.resume();
+      for (size_t call = 0; call < removals; ++call)
+        work.erase(work.begin() + work.size() / 2);
+    }
+    timer.pause();
+    report("erase", width, length, timer, removals * rounds, rounds);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < rounds; ++round) {
+      timer.pause();
+      work = source;
+      timer.resume();
+      for (size_t call = 0; call < removals; ++call)
+        work.erase(work.begin());
+    }
+    timer.pause();
+    report("shift", width, length, timer, removals * rounds, rounds);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round)
+      sink += std::find(source.begin(), source.end(), last) - source.begin();
+    timer.pause();
+    report("find", width, length, timer, length * repeat, repeat);
+  }
+  vector sorted = source;
+  {
+    size_t times = repeat > 16 ? 16 : repeat;
+    probe timer;
+    for (size_t round = 0; round < times; ++round) {
+      timer.pause();
+      sorted = source;
+      timer.resume();
+      std::sort(sorted.begin(), sorted.end());
+    }
+    timer.pause();
+    report("sort", width, length, timer, length * times, times);
+  }
+  {
+    size_t lookups = calls * rounds;
+    probe timer;
+    for (size_t lookup = 0; lookup < lookups; ++lookup)
+      sink += std::binary_search(sorted.begin(), sorted.end(),
+                                 source[mix(lookup) % length]);
+    timer.pause();
+    report("search", width, length, timer, lookups, 1);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round) {
+      vector copy(source);
+      sink += copy.size();
+    }
+    timer.pause();
+    report("clone", width, length, timer, length * repeat, repeat);
+  }
+  {
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round) {
+      vector half(source.begin() + length / 4,
+                  source.begin() + length / 4 + length / 2 + 1);
+      sink += half.size();
+    }
+    timer.pause();
+    report("slice", width, length, timer, (length / 2 + 1) * repeat, repeat);
+  }
+  {
+    /* The element past the end is zero, as with a blox */
+    source.reserve(length + 1);
+    source.push_back(zero);
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round)
+      sink += std::find(source.begin(), source.end(), zero) - source.begin();
+    timer.pause();
+    report("string", width, length, timer, length * repeat, repeat);
+    source.pop_back();
+  }
+  {
+    vector twin(source);
+    probe timer;
+    for (size_t round = 0; round < repeat; ++round)
+      sink += source == twin;
+    timer.pause();
+    report("compare", width, length, timer, length * repeat, repeat);
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t limit = argc > 1 ? size_t(atol(argv[1])) : 1000000;
+  size_t budget = size_t(argc > 2 ? atol(argv[2]) : 512) << 20;
+  void (*suites[])(size_t) = {bench<uint8_t>,  bench<uint16_t>, bench<uint32_t>,
+                              bench<uint64_t>, bench<bytes<16> >,
+                              bench<bytes<32> >, bench<bytes<64> >};
+  size_t widths[] = {1, 2, 4, 8, 16, 32, 64};
+  puts("library,operation,width,length,ns_per_op,bytes_per_op,allocations");
+  for (size_t suite = 0; suite < sizeof(widths) / sizeof(*widths); ++suite)
+    for (size_t length = 10; length <= limit; length *= 10)
+      if (length * widths[suite] <= budget) {
+        suites[suite](length);
+        fflush(stdout);
+      }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ Counts the bytes blox writes through memset/memcpy/memmove for every byte
+ appended, comparing the zero-filling `blox_resize` + copy sequence that
+ `blox_append` used to expand to against the current `blox_append`
+*/
+
+static size_t written = 0;
+
+static void* counted_memset(void* data, int value, size_t size) {
+  written += size;
+  return memset(data, value, size);
+}
+
+static void* counted_memcpy(void* data, const void* source, size_t size) {
+  written += size;
+  return memcpy(data, source, size);
+}
+
+static void* counted_memmove(void* data, const void* source, size_t size) {
+  written += size;
+  return memmove(data, source, size);
+}
+
+#define memset counted_memset
+#define memcpy counted_memcpy
+#define memmove counted_memmove
+
+#include "../blox.h"
+
+#define append_zeroed(TYPE, buffer, other)                   \
+  do {                                                       \
+    size_t length = (buffer).length;                         \
+    size_t additional = (other).length;                      \
+    blox_resize(TYPE, (buffer), length + additional);        \
+    memcpy(blox_index(TYPE, (buffer), length), (other).data, \
+           additional * sizeof(TYPE));                       \
+  } while (0)
+
+void report(const char* name, size_t appended, clock_t start) {
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("%-16s %6.3f bytes written/appended byte, %7.3f s (%.2f GB/s)\n", name,
+         (double)written / appended, seconds, appended / seconds / 1e9);
+}
+
+int main(int argc, char** argv) {
+  size_t chunk = argc > 1 ? (size_t)atol(argv[1]) : 1 << 16;
+  size_t total = argc > 2 ? (size_t)atol(argv[2]) : (size_t)1 << 30;
+  blox source = blox_make(char, chunk);
+  size_t appended = (total / chunk) * chunk;
+
+  blox target = blox_reserved(char, total);
+  written = 0;
+  clock_t start = clock();
+  for (size_t done = 0; done < total; done += chunk)
+    append_zeroed(char, target, source);
+  report("resize + memcpy", appended, start);
+  blox_free(target);
+
+  target = blox_reserved(char, total);
+  written = 0;
+  start = clock();
+  for (size_t done = 0; done < total; done += chunk)
+    blox_append(char, target, source);
+  report("blox_append", appended, start);
+
+  written = 0;
+  start = clock();
+  blox copy = blox_clone(char, target);
+  report("blox_clone", target.length, start);
+
+  blox_free(copy);
+  blox_free(target);
+  blox_free(source);
+  return 0;
+}
@@ -27,12 +27,175 @@ SOFTWARE.
 #define BLOX_H_INCLUDED
 
 #include <memory.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#if !defined(BLOX_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define BLOX_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BLOX_TARGET(features)
+#define BLOX_NO_SANITIZE
+#else
+#define BLOX_TARGET(features) __attribute__((target(features)))
+#define BLOX_NO_SANITIZE __attribute__((no_sanitize_address))
+#endif
+
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define BLOX_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define BLOX_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define BLOX_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define BLOX_THREAD_LOCAL __thread
+#else
+#define BLOX_THREAD_LOCAL
+#endif
+
+/*
+ Address of `value` converted to TYPE, valid until the end of the full
+ expression (C++ has no compound literals, so bind a reference instead)
+*/
+#ifdef __cplusplus
+template <typename TYPE>
+const TYPE* blox__temporary_(const TYPE& value) {
+  return &value;
+}
+#define BLOX__TEMPORARY(TYPE, value) blox__temporary_<TYPE>(value)
+#else
+#define BLOX__TEMPORARY(TYPE, value) (&(TYPE){(value)})
+#endif
+
+int blox_ctz_(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (int)index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+int blox_clz_(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - (int)index;
+#else
+  return __builtin_clzll(value);
+#endif
+}
+
+int blox_popcount_(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  value = value - ((value >> 1) & 0x5555555555555555ULL);
+  value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+  value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((value * 0x0101010101010101ULL) >> 56);
+#else
+  return __builtin_popcountll(value);
+#endif
+}
+
+/*
+ Returns non-zero if AVX2 kernels may be used on this machine
+*/
+int blox_cpu_avx2_(void) {
+#if !defined(BLOX_SIMD_X86)
+  return 0;
+#elif defined(_MSC_VER) && !defined(__clang__)
+  static int supported = -1;
+  if (supported < 0) {
+    int info[4];
+    __cpuid(info, 1);
+    int usable = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    supported = usable && (info[1] & (1 << 5));
+  }
+  return supported;
+#else
+  static int supported = -1;
+  if (supported < 0) {
+    __builtin_cpu_init();
+    supported = __builtin_cpu_supports("avx2") != 0;
+  }
+  return supported;
+#endif
+}
+
+#ifndef BLOX_PAGE_SIZE
+#define BLOX_PAGE_SIZE 4096
+#endif
+
+/*
+ Growth policy: returns the new capacity (in elements, and greater than
+ `request`) for a container which has run out of room
+*/
+typedef size_t (*blox_growth)(size_t capacity, size_t request, size_t width);
+
+size_t blox_grow_double(size_t capacity, size_t request, size_t width) {
+  (void)width;
+  if (!capacity)
+    ++capacity;
+  while (capacity <= request)
+    capacity <<= 1;
+  return capacity;
+}
+
+size_t blox_grow_by_half(size_t capacity, size_t request, size_t width) {
+  (void)width;
+  if (capacity < 2)
+    capacity = 2;
+  while (capacity <= request)
+    capacity += capacity >> 1;
+  return capacity;
+}
+
+size_t blox_grow_exact(size_t capacity, size_t request, size_t width) {
+  (void)capacity;
+  (void)width;
+  return request + 1;
+}
+
+/*
+ Doubles while small, then grows by half rounded up to whole pages
+*/
+size_t blox_grow_pages(size_t capacity, size_t request, size_t width) {
+  size_t size = blox_grow_by_half(capacity, request, width) * width;
+  if (size < BLOX_PAGE_SIZE)
+    return blox_grow_double(capacity, request, width);
+  size = (size + (BLOX_PAGE_SIZE - 1)) & ~(size_t)(BLOX_PAGE_SIZE - 1);
+  return size / width;
+}
+
+/*
+ Allocator interface. Every callback receives `context` as its first
+ argument. `reallocate` may be NULL, in which case growth falls back to
+ `allocate` + copy + `release`. Sizes are in bytes. A NULL `growth`
+ means `blox_grow_double`.
+*/
+typedef struct {
+  void* (*allocate)(void* context, size_t size, size_t alignment);
+  void* (*reallocate)(void* context,
+                      void* data,
+                      size_t size,
+                      size_t request,
+                      size_t alignment);
+  void (*release)(void* context, void* data);
+  void* context;
+  size_t alignment;
+  blox_growth growth;
+} blox_heap;
+
 typedef struct {
   void* data;
   size_t length;
   size_t capacity;
+  blox_heap* heap;
 } blox;
 
 typedef void* (*blox_allocator)(void*, size_t);
@@ -44,6 +207,394 @@ blox_allocator blox_realloc(blox_allocator reset) {
   return alloc;
 }
 
+void* blox_default_allocate_(void* context, size_t size, size_t alignment) {
+  (void)context;
+  (void)alignment;
+  return blox_realloc(NULL)(NULL, size);
+}
+
+void* blox_default_reallocate_(void* context,
+                               void* data,
+                               size_t size,
+                               size_t request,
+                               size_t alignment) {
+  (void)context;
+  (void)size;
+  (void)alignment;
+  return blox_realloc(NULL)(data, request);
+}
+
+void blox_default_release_(void* context, void* data) {
+  (void)context;
+  blox_realloc(NULL)(data, 0);
+}
+
+/*
+ The default heap forwards to whatever `blox_realloc` is set to
+*/
+blox_heap* blox_default_heap(void) {
+  static blox_heap heap = {blox_default_allocate_, blox_default_reallocate_,
+                           blox_default_release_, NULL, 0, NULL};
+  return &heap;
+}
+
+/*
+ Marks storage the container doesn't own (views, inline buffers); it is
+ never released, and growing it copies the elements to the current heap
+*/
+blox_heap* blox_borrowed_heap(void) {
+  static blox_heap heap = {0};
+  return &heap;
+}
+
+blox_heap** blox_scope_heap_(void) {
+  static BLOX_THREAD_LOCAL blox_heap* scope = NULL;
+  return &scope;
+}
+
+/*
+ Sets the heap used by containers of the calling thread that don't have
+ one attached yet; returns the previous one (NULL restores the default)
+*/
+blox_heap* blox_heap_scope(blox_heap* heap) {
+  blox_heap** scope = blox_scope_heap_();
+  blox_heap* previous = *scope;
+  *scope = heap;
+  return previous;
+}
+
+blox_heap* blox_current_heap(void) {
+  blox_heap* heap = *blox_scope_heap_();
+  return heap ? heap : blox_default_heap();
+}
+
+blox_heap* blox_heap_of_(blox* buffer) {
+  if (buffer->heap == NULL)
+    buffer->heap = blox_current_heap();
+  return buffer->heap;
+}
+
+/*
+ Opt-in instrumentation (define BLOX_STATS before including): counts
+ reallocations, bytes allocated, moved and zeroed, and the peak capacity
+ in bytes, per call site (the line of the outermost blox macro) or per
+ tag set with `blox_stats_tag`. Without BLOX_STATS every hook expands to
+ nothing.
+*/
+#ifdef BLOX_STATS
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef BLOX_STATS_SITES
+#define BLOX_STATS_SITES 1024
+#endif
+
+enum {
+  BLOX_STATS_REALLOCATIONS,
+  BLOX_STATS_ALLOCATED,
+  BLOX_STATS_MOVED,
+  BLOX_STATS_ZEROED,
+  BLOX_STATS_PEAK,
+  BLOX_STATS_FIELDS
+};
+
+enum { BLOX_STATS_TEXT, BLOX_STATS_CSV };
+
+typedef struct {
+  const char* file;
+  int line;
+  const char* tag;
+  size_t counts[BLOX_STATS_FIELDS];
+} blox_stats_entry;
+
+typedef struct {
+  const char* file;
+  int line;
+  const char* tag;
+  blox_stats_entry* entry;
+} blox_stats_site;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define blox__lock(flag) \
+  while (_InterlockedExchange(flag, 1)) {}
+#define blox__unlock(flag) _InterlockedExchange(flag, 0)
+#else
+#define blox__lock(flag) \
+  while (__atomic_exchange_n(flag, 1, __ATOMIC_ACQUIRE)) {}
+#define blox__unlock(flag) __atomic_store_n(flag, 0, __ATOMIC_RELEASE)
+#endif
+
+typedef struct {
+  long lock;
+  size_t used;
+  blox_stats_entry entries[BLOX_STATS_SITES];
+} blox_stats_table;
+
+blox_stats_table* blox_stats_table_(void) {
+  static blox_stats_table table;
+  return &table;
+}
+
+blox_stats_site* blox_stats_current_(void) {
+  static BLOX_THREAD_LOCAL blox_stats_site site;
+  return &site;
+}
+
+/*
+ Finds or claims the entry of a site or tag; the last one is shared by
+ everything that doesn't fit
+*/
+blox_stats_entry* blox_stats_entry_(const char* file,
+                                    int line,
+                                    const char* tag) {
+  blox_stats_table* table = blox_stats_table_();
+  blox_stats_entry* found = NULL;
+  blox__lock(&table->lock);
+  for (size_t index = 0; index < table->used && !found; ++index) {
+    blox_stats_entry* entry = table->entries + index;
+    if (tag ? entry->tag && strcmp(entry->tag, tag) == 0
+            : !entry->tag && entry->line == line &&
+                  strcmp(entry->file, file) == 0)
+      found = entry;
+  }
+  if (!found && table->used < BLOX_STATS_SITES - 1) {
+    found = table->entries + table->used++;
+    found->file = tag ? "" : file;
+    found->line = tag ? 0 : line;
+    found->tag = tag;
+  } else if (!found) {
+    found = table->entries + BLOX_STATS_SITES - 1;
+    found->file = "(other)";
+    table->used = BLOX_STATS_SITES;
+  }
+  blox__unlock(&table->lock);
+  return found;
+}
+
+void blox_stats_site_(const char* file, int line) {
+  blox_stats_site* site = blox_stats_current_();
+  if (site->tag || (site->entry && site->line == line && site->file == file))
+    return;
+  site->file = file;
+  site->line = line;
+  site->entry = blox_stats_entry_(file, line, NULL);
+}
+
+/*
+ Attributes everything the calling thread does to `tag` (NULL goes back
+ to call sites); returns the previous tag
+*/
+const char* blox_stats_tag(const char* tag) {
+  blox_stats_site* site = blox_stats_current_();
+  const char* previous = site->tag;
+  site->tag = tag;
+  site->entry = tag ? blox_stats_entry_(NULL, 0, tag) : NULL;
+  return previous;
+}
+
+void blox_stats_count_(int field, size_t amount) {
+  blox_stats_site* site = blox_stats_current_();
+  blox_stats_table* table = blox_stats_table_();
+  if (site->entry == NULL)
+    site->entry = blox_stats_entry_("(unknown)", 0, NULL);
+  blox__lock(&table->lock);
+  size_t* count = site->entry->counts + field;
+  if (field == BLOX_STATS_PEAK)
+    *count = amount > *count ? amount : *count;
+  else
+    *count += amount;
+  blox__unlock(&table->lock);
+}
+
+void blox_stats_reset(void) {
+  blox_stats_table* table = blox_stats_table_();
+  blox__lock(&table->lock);
+  for (size_t index = 0; index < table->used; ++index)
+    memset(table->entries[index].counts, 0,
+           sizeof(table->entries[index].counts));
+  blox__unlock(&table->lock);
+}
+
+/*
+ Returns a copy of all entries (a blox of `blox_stats_entry`, to be freed
+ with `blox_free`)
+*/
+blox blox_stats_snapshot(void) {
+  blox_stats_table* table = blox_stats_table_();
+  blox snapshot = {0};
+  size_t width = sizeof(blox_stats_entry);
+  size_t room = BLOX_STATS_SITES + 1;
+  snapshot.data = blox_realloc(NULL)(NULL, room * width);
+  if (snapshot.data == NULL)
+    return snapshot;
+  blox__lock(&table->lock);
+  snapshot.length = table->used;
+  memcpy(snapshot.data, table->entries, table->used * width);
+  blox__unlock(&table->lock);
+  memset((unsigned char*)snapshot.data + snapshot.length * width, 0, width);
+  snapshot.capacity = room;
+  snapshot.heap = blox_default_heap();
+  return snapshot;
+}
+
+int blox_stats_order_(const void* lhs, const void* rhs) {
+  const size_t* left = ((const blox_stats_entry*)lhs)->counts;
+  const size_t* right = ((const blox_stats_entry*)rhs)->counts;
+  if (left[BLOX_STATS_REALLOCATIONS] != right[BLOX_STATS_REALLOCATIONS])
+    return left[BLOX_STATS_REALLOCATIONS] < right[BLOX_STATS_REALLOCATIONS]
+               ? 1
+               : -1;
+  return (left[BLOX_STATS_MOVED] < right[BLOX_STATS_MOVED]) -
+         (left[BLOX_STATS_MOVED] > right[BLOX_STATS_MOVED]);
+}
+
+/*
+ Writes the statistics as a table (busiest sites first) or as CSV
+*/
+void blox_stats_dump(FILE* stream, int format) {
+  blox snapshot = blox_stats_snapshot();
+  blox_stats_entry* entries = (blox_stats_entry*)snapshot.data;
+  if (entries == NULL)
+    return;
+  qsort(entries, snapshot.length, sizeof(blox_stats_entry),
+        blox_stats_order_);
+  if (format == BLOX_STATS_CSV)
+    fputs("site,line,tag,reallocations,allocated,moved,zeroed,peak\n", stream);
+  else
+    fprintf(stream, "%-40s %10s %14s %14s %14s %14s\n", "site",
+            "reallocs", "allocated", "moved", "zeroed", "peak");
+  for (size_t index = 0; index < snapshot.length; ++index) {
+    blox_stats_entry* entry = entries + index;
+    const size_t* counts = entry->counts;
+    char site[40];
+    if (format == BLOX_STATS_CSV) {
+      fprintf(stream, "\"%s\",%d,\"%s\",%zu,%zu,%zu,%zu,%zu\n", entry->file,
+              entry->line, entry->tag ? entry->tag : "",
+              counts[BLOX_STATS_REALLOCATIONS], counts[BLOX_STATS_ALLOCATED],
+              counts[BLOX_STATS_MOVED], counts[BLOX_STATS_ZEROED],
+              counts[BLOX_STATS_PEAK]);
+      continue;
+    }
+    if (entry->tag)
+      snprintf(site, sizeof(site), "[%s]", entry->tag);
+    else
+      snprintf(site, sizeof(site), "%s:%d", entry->file, entry->line);
+    fprintf(stream, "%-40s %10zu %14zu %14zu %14zu %14zu\n", site,
+            counts[BLOX_STATS_REALLOCATIONS], counts[BLOX_STATS_ALLOCATED],
+            counts[BLOX_STATS_MOVED], counts[BLOX_STATS_ZEROED],
+            counts[BLOX_STATS_PEAK]);
+  }
+  blox_realloc(NULL)(snapshot.data, 0);
+}
+
+#define BLOX__STAT_SITE() blox_stats_site_(__FILE__, __LINE__)
+#define BLOX__STAT(field, amount) \
+  blox_stats_count_(BLOX_STATS_##field, (size_t)(amount))
+#define BLOX__SITED(expression) (BLOX__STAT_SITE(), (expression))
+
+#else
+
+#define BLOX__STAT_SITE() ((void)0)
+#define BLOX__STAT(field, amount) ((void)0)
+#define BLOX__SITED(expression) (expression)
+
+#define blox_stats_tag(tag) ((const char*)NULL)
+#define blox_stats_reset() ((void)0)
+#define blox_stats_snapshot() blox_nil()
+#define blox_stats_dump(stream, format) ((void)0)
+
+#endif  // BLOX_STATS
+
+int blox_reallocate_(blox* buffer, size_t width, size_t capacity) {
+  blox_heap* heap = blox_heap_of_(buffer);
+  size_t size = buffer->capacity * width;
+  size_t request = capacity * width;
+  void* chunk;
+  if (heap == blox_borrowed_heap()) {
+    heap = blox_current_heap();
+    chunk = heap->allocate(heap->context, request, heap->alignment);
+    if (chunk == NULL)
+      return 0;
+    if (buffer->data != NULL) {
+      memcpy(chunk, buffer->data, size < request ? size : request);
+      BLOX__STAT(MOVED, size < request ? size : request);
+    }
+    buffer->heap = heap;
+  } else if (buffer->data == NULL)
+    chunk = heap->allocate(heap->context, request, heap->alignment);
+  else if (heap->reallocate)
+    chunk = heap->reallocate(heap->context, buffer->data, size, request,
+                             heap->alignment);
+  else {
+    chunk = heap->allocate(heap->context, request, heap->alignment);
+    if (chunk != NULL) {
+      memcpy(chunk, buffer->data, size < request ? size : request);
+      BLOX__STAT(MOVED, size < request ? size : request);
+      heap->release(heap->context, buffer->data);
+    }
+  }
+  if (chunk == NULL)
+    return 0;
+  BLOX__STAT(REALLOCATIONS, 1);
+  BLOX__STAT(ALLOCATED, request);
+  BLOX__STAT(PEAK, request);
+  buffer->data = chunk;
+  buffer->capacity = capacity;
+  return 1;
+}
+
+/*
+ Makes sure there is room for `request` elements plus a terminator,
+ growing according to the policy of the container's heap
+*/
+int blox_ensure_(blox* buffer, size_t width, size_t request) {
+  size_t capacity = buffer->capacity;
+  if (request < capacity)
+    return 1;
+  if (request >= ((size_t)-1 / width) / 2)
+    return 0;
+  blox_growth growth = blox_heap_of_(buffer)->growth;
+  if (growth == NULL)
+    growth = blox_grow_double;
+  return blox_reallocate_(buffer, width, growth(capacity, request, width));
+}
+
+/*
+ Same as `blox_ensure_`, but reserves exactly `request` elements (plus a
+ terminator) regardless of growth policy
+*/
+int blox_reserve_(blox* buffer, size_t width, size_t request) {
+  if (request < buffer->capacity)
+    return 1;
+  if (request >= ((size_t)-1 / width) / 2)
+    return 0;
+  return blox_reallocate_(buffer, width, request + 1);
+}
+
+void blox_release_(blox* buffer) {
+  if (buffer->data == NULL)
+    return;
+  blox_heap* heap = buffer->heap ? buffer->heap : blox_default_heap();
+  if (heap != blox_borrowed_heap())
+    heap->release(heap->context, buffer->data);
+}
+
+/*
+ Lowers capacity to what is actually in use (empty containers give back
+ all of their memory)
+*/
+void blox_fit_(blox* buffer, size_t width) {
+  if (buffer->data == NULL || buffer->heap == blox_borrowed_heap())
+    return;
+  if (buffer->length == 0) {
+    blox_release_(buffer);
+    buffer->data = NULL;
+    buffer->capacity = 0;
+  } else if (buffer->length + 1 < buffer->capacity)
+    blox_reallocate_(buffer, width, buffer->length + 1);
+}
+
 blox blox_nil(void) {
   blox nil = {0};
   return nil;
@@ -64,10 +615,11 @@ blox blox_nil(void) {
 
 #define blox_capacity(buffer) (buffer).capacity
 
-#define blox_make(TYPE, length) blox_make_(sizeof(TYPE), length, 0)
+#define blox_make(TYPE, length) \
+  BLOX__SITED(blox_make_(sizeof(TYPE), length, 0))
 
 blox blox_use_(const void* data, size_t length) {
-  blox buffer = {(void*)data, length, length};
+  blox buffer = {(void*)data, length, length, blox_borrowed_heap()};
   return buffer;
 }
 
@@ -83,11 +635,15 @@ blox blox_use_(const void* data, size_t length) {
   blox_use(blox_index(TYPE, other, start), length)
 
 #define blox_use_window(TYPE, other, start, end) \
-  blox_use_view(other, start, blox__safe_subtract(end, start))
+  blox_use_view(TYPE, other, start, blox__safe_subtract(end, start))
 
 #define blox__safe_last(buffer) blox__safe_subtract((buffer).length, 1)
 
-#define blox_use_string(TYPE, string) blox_use_string_(sizeof(TYPE), string)
+#define blox_use_string(TYPE, string) \
+  blox_use_string_(sizeof(TYPE), string, (size_t)-1)
+
+#define blox_use_string_n(TYPE, string, limit) \
+  blox_use_string_(sizeof(TYPE), string, limit)
 
 #define blox_from_array(TYPE, array, length) \
   blox_clone(TYPE, blox_use_array(TYPE, array, length))
@@ -95,10 +651,14 @@ blox blox_use_(const void* data, size_t length) {
 #define blox_from_string(TYPE, string) \
   blox_clone(TYPE, blox_use_string(TYPE, string))
 
+#define blox_from_string_n(TYPE, string, limit) \
+  blox_clone(TYPE, blox_use_string_n(TYPE, string, limit))
+
 #define blox_from_sequence(TYPE, start, end) \
   blox_clone(TYPE, blox_use_sequence(TYPE, start, end))
 
-#define blox_reserved(TYPE, length) blox_make_(sizeof(TYPE), length, 1)
+#define blox_reserved(TYPE, length) \
+  BLOX__SITED(blox_make_(sizeof(TYPE), length, 1))
 
 #define blox_create(TYPE) blox_make(TYPE, 0)
 
@@ -109,7 +669,7 @@ blox blox_use_(const void* data, size_t length) {
   blox_slice(TYPE, buffer, start, blox__safe_subtract(end, start))
 
 #define blox_slice_end(TYPE, buffer, start) \
- blox_slice_range(TYPE, buffer, start, (buffer).length))
+  blox_slice_range(TYPE, buffer, start, (buffer).length)
 
 #define blox_slice_first(TYPE, buffer, amount) \
   blox_slice(TYPE, buffer, 0,                  \
@@ -117,7 +677,7 @@ blox blox_use_(const void* data, size_t length) {
 
 #define blox_slice_last(TYPE, buffer, amount)                            \
   blox_slice(TYPE, buffer, blox__safe_subtract((buffer).length, amount), \
-             amount < (buffer).length ? amount : 0)
+             amount < (buffer).length ? amount : (buffer).length)
 
 #define blox_shrink(TYPE, buffer) blox_resize(TYPE, buffer, 0)
 
@@ -130,8 +690,10 @@ blox blox_use_(const void* data, size_t length) {
 #define blox_clear_at(TYPE, buffer, start, amount)      \
   do {                                                  \
     TYPE* cursor = blox_index(TYPE, (buffer), (start)); \
-    if ((cursor + amount) >= blox_end(TYPE, (buffer)))  \
+    if ((cursor + amount) > blox_end(TYPE, (buffer)))   \
       break;                                            \
+    BLOX__STAT_SITE();                                  \
+    BLOX__STAT(ZEROED, amount * sizeof(TYPE));          \
     memset(cursor, 0, amount * sizeof(TYPE));           \
   } while (0)
 
@@ -146,60 +708,65 @@ blox blox_use_(const void* data, size_t length) {
 
 #define blox_erase(TYPE, buffer, index) blox_erase_at(TYPE, buffer, index, 1)
 
-#define blox_erase_at(TYPE, buffer, start, amount)                    \
-  do {                                                                \
-    TYPE* begin = blox_index(TYPE, (buffer), start);                  \
-    size_t length = (buffer).length;                                  \
-    memmove(begin, begin + amount, sizeof(TYPE) * (length - amount)); \
-    blox_shrink_by(TYPE, (buffer), amount);                           \
+#define blox_erase_at(TYPE, buffer, start, amount)       \
+  do {                                                   \
+    TYPE* begin = blox_index(TYPE, (buffer), start);     \
+    size_t tail = (buffer).length - (start) - (amount);  \
+    BLOX__STAT_SITE();                                   \
+    BLOX__STAT(MOVED, sizeof(TYPE) * tail);              \
+    memmove(begin, begin + amount, sizeof(TYPE) * tail); \
+    blox_shrink_by(TYPE, (buffer), amount);              \
   } while (0)
 
 #define blox_erase_range(TYPE, buffer, start, end) \
   blox_erase_at(TYPE, buffer, start, blox__safe_subtract(end, start))
 
-#define blox_insert(TYPE, buffer, index, value) \
-  do {                                          \
-    size_t position = (index);                  \
-    size_t end = (buffer).length;               \
-    if (position >= end)                        \
-      blox_resize(TYPE, buffer, position + 1);  \
-    blox_set(TYPE, buffer, position, (value));  \
+#define blox_insert(TYPE, buffer, index, value)    \
+  do {                                             \
+    size_t position = (index);                     \
+    size_t end = (buffer).length;                  \
+    if (position == end)                           \
+      blox_resize_raw(TYPE, buffer, position + 1); \
+    else if (position > end)                       \
+      blox_resize(TYPE, buffer, position + 1);     \
+    blox_set(TYPE, buffer, position, (value));     \
   } while (0)
 
-#define blox_resize(TYPE, buffer, size)                               \
-  do {                                                                \
-    size_t request = (size);                                          \
-    size_t capacity = (buffer).capacity;                              \
-    size_t length = (buffer).length;                                  \
-    if (request == length)                                            \
-      break;                                                          \
-    if (request >= capacity) {                                        \
-      if (!capacity)                                                  \
-        ++capacity;                                                   \
-      while (capacity <= request)                                     \
-        capacity <<= 1;                                               \
-      void* chunk =                                                   \
-          blox_realloc(NULL)((buffer).data, capacity * sizeof(TYPE)); \
-      if (chunk == NULL)                                              \
-        break;                                                        \
-      (buffer).data = chunk;                                          \
-      (buffer).capacity = capacity;                                   \
-    }                                                                 \
-    if (request > length)                                             \
-      memset(blox_index(TYPE, buffer, length), 0,                     \
-             ((request - length) + 1) * sizeof(TYPE));                \
-    else                                                              \
-      memset(blox_index(TYPE, buffer, request), 0, sizeof(TYPE));     \
-    (buffer).length = request;                                        \
+#define blox__resize(TYPE, buffer, size, fill)                  \
+  do {                                                          \
+    size_t request = (size);                                    \
+    size_t length = (buffer).length;                            \
+    if (request == length)                                      \
+      break;                                                    \
+    BLOX__STAT_SITE();                                          \
+    if (!blox_ensure_(&(buffer), sizeof(TYPE), request))        \
+      break;                                                    \
+    if ((fill) && request > length) {                           \
+      BLOX__STAT(ZEROED, (request - length) * sizeof(TYPE));    \
+      memset(blox_index(TYPE, buffer, length), 0,               \
+             (request - length) * sizeof(TYPE));                \
+    }                                                           \
+    memset(blox_index(TYPE, buffer, request), 0, sizeof(TYPE)); \
+    (buffer).length = request;                                  \
   } while (0)
 
-#define blox_reserve(TYPE, buffer, size) \
-  do {                                   \
-    size_t saved = (buffer).length;      \
-    blox_resize(TYPE, buffer, size);     \
-    (buffer).length = saved;             \
+#define blox_resize(TYPE, buffer, size) blox__resize(TYPE, buffer, size, 1)
+
+#define blox_resize_raw(TYPE, buffer, size) \
+  blox__resize(TYPE, buffer, size, 0)
+
+#define blox_reserve(TYPE, buffer, size)                 \
+  do {                                                   \
+    size_t request = (size);                             \
+    BLOX__STAT_SITE();                                   \
+    if (request > (buffer).length &&                     \
+        blox_reserve_(&(buffer), sizeof(TYPE), request)) \
+      memset(blox_end(TYPE, buffer), 0, sizeof(TYPE));   \
   } while (0)
 
+#define blox_shrink_to_fit(TYPE, buffer) \
+  BLOX__SITED(blox_fit_(&(buffer), sizeof(TYPE)))
+
 #define blox_stuff(TYPE, buffer) \
   blox_resize(TYPE, buffer, blox_length(buffer) + 1)
 
@@ -230,16 +797,18 @@ blox blox_use_(const void* data, size_t length) {
     blox_resize(TYPE, buffer, length);       \
   } while (0)
 
-#define blox_shift_by(TYPE, buffer, amount)        \
-  do {                                             \
-    if (amount == 0)                               \
-      break;                                       \
-    TYPE* begin = blox_begin(TYPE, (buffer));      \
-    TYPE* cursor = begin + (amount);           \
-    if (cursor > blox_end(TYPE, (buffer)))         \
-      break;                                       \
+#define blox_shift_by(TYPE, buffer, amount)                              \
+  do {                                                                   \
+    if (amount == 0)                                                     \
+      break;                                                             \
+    TYPE* begin = blox_begin(TYPE, (buffer));                            \
+    TYPE* cursor = begin + (amount);                                     \
+    if (cursor > blox_end(TYPE, (buffer)))                               \
+      break;                                                             \
+    BLOX__STAT_SITE();                                                   \
+    BLOX__STAT(MOVED, sizeof(TYPE) * ((buffer).length - (amount)));      \
     memmove(begin, cursor, sizeof(TYPE) * ((buffer).length - (amount))); \
-    blox_shrink_by(TYPE, (buffer), amount);        \
+    blox_shrink_by(TYPE, (buffer), amount);                              \
   } while (0)
 
 #define blox_shift(TYPE, buffer) blox_shift_by(TYPE, buffer, 1)
@@ -247,8 +816,9 @@ blox blox_use_(const void* data, size_t length) {
 #define blox_unshift(TYPE, buffer, value)             \
   do {                                                \
     size_t length = (buffer).length;                  \
-    blox_resize(TYPE, (buffer), length + 1);          \
+    blox_resize_raw(TYPE, (buffer), length + 1);      \
     TYPE* begin = blox_begin(TYPE, buffer);           \
+    BLOX__STAT(MOVED, length * sizeof(TYPE));         \
     memmove(begin + 1, begin, length * sizeof(TYPE)); \
     blox_set(TYPE, (buffer), 0, value);               \
   } while (0)
@@ -256,17 +826,20 @@ blox blox_use_(const void* data, size_t length) {
 #define blox_unshift_by(TYPE, buffer, amount)              \
   do {                                                     \
     size_t length = (buffer).length;                       \
-    blox_resize(TYPE, (buffer), length + amount);          \
+    blox_resize_raw(TYPE, (buffer), length + amount);      \
     TYPE* begin = blox_begin(TYPE, buffer);                \
+    BLOX__STAT(MOVED, length * sizeof(TYPE));              \
+    BLOX__STAT(ZEROED, amount * sizeof(TYPE));             \
     memmove(begin + amount, begin, length * sizeof(TYPE)); \
-    blox_clear_at(TYPE, (buffer), 0, amount);              \
+    memset(begin, 0, amount * sizeof(TYPE));               \
   } while (0)
 
 #define blox_append(TYPE, buffer, other)                     \
   do {                                                       \
     size_t length = (buffer).length;                         \
     size_t additional = (other).length;                      \
-    blox_resize(TYPE, (buffer), length + additional);        \
+    blox_resize_raw(TYPE, (buffer), length + additional);    \
+    BLOX__STAT(MOVED, additional * sizeof(TYPE));            \
     memcpy(blox_index(TYPE, (buffer), length), (other).data, \
            additional * sizeof(TYPE));                       \
   } while (0)
@@ -284,8 +857,9 @@ blox blox_use_(const void* data, size_t length) {
   do {                                                                   \
     size_t length = (buffer).length;                                     \
     size_t additional = (other).length;                                  \
-    blox_resize(TYPE, (buffer), length + additional);                    \
+    blox_resize_raw(TYPE, (buffer), length + additional);                \
     TYPE* begin = blox_index(TYPE, buffer, index);                       \
+    BLOX__STAT(MOVED, (length - index + additional) * sizeof(TYPE));     \
     memmove(begin + additional, begin, (length - index) * sizeof(TYPE)); \
     memcpy(begin, (other).data, additional * sizeof(TYPE));              \
   } while (0)
@@ -317,7 +891,7 @@ blox blox_use_(const void* data, size_t length) {
   } while (0)
 
 #define blox_clone(TYPE, buffer) \
-  blox_clone_(sizeof(TYPE), (buffer).data, (buffer).length)
+  BLOX__SITED(blox_clone_(sizeof(TYPE), (buffer).data, (buffer).length))
 
 #define blox_swap(buffer, other) \
   do {                           \
@@ -338,12 +912,14 @@ blox blox_use_(const void* data, size_t length) {
     }                                      \
   } while (0)
 
-#define blox_free(buffer) \
-  do {                    \
-    blox_realloc(NULL)((buffer).data, 0);  \
-    blox_drop(buffer);    \
+#define blox_free(buffer)      \
+  do {                         \
+    blox_release_(&(buffer));  \
+    blox_drop(buffer);         \
   } while (0)
 
+#define blox_attach(buffer, allocator) ((buffer).heap = (allocator))
+
 #define blox_offset(TYPE, buffer, pointer) \
   blox__safe_subtract((TYPE*)pointer, (TYPE*)(buffer).data)
 
@@ -365,43 +941,142 @@ blox blox_use_(const void* data, size_t length) {
 
 blox blox_make_(size_t width, size_t length, int reserved) {
   blox buffer = {0};
-  size_t size = length * width;
+  if (length == 0 || !blox_reserve_(&buffer, width, length))
+    return buffer;
   if (reserved)
-    blox_reserve(char, buffer, size);
-  else
-    blox_resize(char, buffer, size);
-  buffer.length /= width;
-  buffer.capacity /= width;
+    memset(buffer.data, 0, width);
+  else {
+    BLOX__STAT(ZEROED, length * width);
+    memset(buffer.data, 0, (length + 1) * width);
+    buffer.length = length;
+  }
   return buffer;
 }
 
+/*
+ Only the terminator is zeroed, the rest is copied over exactly once
+*/
 blox blox_clone_(size_t width, const void* data, size_t length) {
+  blox buffer = {0};
+  if (length == 0 || !blox_reserve_(&buffer, width, length))
+    return buffer;
   size_t size = length * width;
-  blox buffer = blox_make(char, size);
+  BLOX__STAT(MOVED, size);
   memcpy(buffer.data, data, size);
+  memset((unsigned char*)buffer.data + size, 0, width);
   buffer.length = length;
-  buffer.capacity /= width;
   return buffer;
 }
 
-blox blox_use_string_(size_t width, const void* data) {
+/*
+ Number of elements preceding the first all-zero element (at most `limit`)
+*/
+size_t blox_string_length_scalar_(const void* data,
+                                  size_t width,
+                                  size_t limit) {
   typedef unsigned char byte;
-  byte* base = ((byte*)data);
-  byte* current = base;
-  for (;;) {
-    size_t count = width;
-    do {
-      if (*current != 0) {
-        current += count;
-        break;
-      } else
-        ++current;
-    } while (--count);
-    if (count == 0)
-      break;
+  const byte* current = (const byte*)data;
+  for (size_t index = 0; index < limit; ++index, current += width) {
+    size_t zeroes = 0;
+    while (zeroes < width && current[zeroes] == 0)
+      ++zeroes;
+    if (zeroes == width)
+      return index;
+  }
+  return limit;
+}
+
+#ifdef BLOX_SIMD_X86
+
+/*
+ Loads are aligned to the vector size, so they never cross a page
+ boundary (even though they may read past the terminator)
+*/
+#define BLOX__ZERO_KERNEL(NAME, FEATURES, VECTOR, LOAD, MASK, ZERO, EQUAL)   \
+  BLOX_TARGET(FEATURES)                                                      \
+  BLOX_NO_SANITIZE                                                           \
+  size_t NAME(const void* data, size_t width, size_t limit) {                \
+    typedef unsigned char byte;                                              \
+    const byte* start = (const byte*)data;                                   \
+    size_t step = sizeof(VECTOR);                                            \
+    const byte* block =                                                      \
+        (const byte*)((uintptr_t)start & ~(uintptr_t)(step - 1));            \
+    VECTOR zero = ZERO;                                                      \
+    uint64_t mask = (uint32_t)MASK(EQUAL(LOAD((const VECTOR*)block), zero)); \
+    mask &= ~(uint64_t)0 << (start - block);                                 \
+    for (;;) {                                                               \
+      if (mask) {                                                            \
+        size_t index = (size_t)(block + blox_ctz_(mask) - start) / width;    \
+        return index < limit ? index : limit;                                \
+      }                                                                      \
+      block += step;                                                         \
+      if ((size_t)(block - start) / width >= limit)                          \
+        return limit;                                                        \
+      mask = (uint32_t)MASK(EQUAL(LOAD((const VECTOR*)block), zero));        \
+    }                                                                        \
   }
-  size_t length = ((current - base) / width) - 1;
-  blox buffer = {base, length, length};
+
+#define blox__cmpeq64_sse2(block, zero)                 \
+  _mm_and_si128(_mm_cmpeq_epi32(block, zero),           \
+                _mm_shuffle_epi32(_mm_cmpeq_epi32(block, zero), 0xB1))
+
+BLOX__ZERO_KERNEL(blox_string_length_sse2_16_, "sse2", __m128i,
+                  _mm_load_si128, _mm_movemask_epi8, _mm_setzero_si128(),
+                  _mm_cmpeq_epi16)
+BLOX__ZERO_KERNEL(blox_string_length_sse2_32_, "sse2", __m128i,
+                  _mm_load_si128, _mm_movemask_epi8, _mm_setzero_si128(),
+                  _mm_cmpeq_epi32)
+BLOX__ZERO_KERNEL(blox_string_length_sse2_64_, "sse2", __m128i,
+                  _mm_load_si128, _mm_movemask_epi8, _mm_setzero_si128(),
+                  blox__cmpeq64_sse2)
+BLOX__ZERO_KERNEL(blox_string_length_avx2_16_, "avx2", __m256i,
+                  _mm256_load_si256, _mm256_movemask_epi8,
+                  _mm256_setzero_si256(), _mm256_cmpeq_epi16)
+BLOX__ZERO_KERNEL(blox_string_length_avx2_32_, "avx2", __m256i,
+                  _mm256_load_si256, _mm256_movemask_epi8,
+                  _mm256_setzero_si256(), _mm256_cmpeq_epi32)
+BLOX__ZERO_KERNEL(blox_string_length_avx2_64_, "avx2", __m256i,
+                  _mm256_load_si256, _mm256_movemask_epi8,
+                  _mm256_setzero_si256(), _mm256_cmpeq_epi64)
+
+#endif  // BLOX_SIMD_X86
+
+/*
+ Width-specialized terminator search: libc for bytes, vector compares
+ against zero for 2, 4 and 8 byte elements (as long as they are aligned)
+*/
+size_t blox_string_length_(const void* data, size_t width, size_t limit) {
+  if (width == 1) {
+    if (limit == (size_t)-1)
+      return strlen((const char*)data);
+    const void* found = memchr(data, 0, limit);
+    return found ? (size_t)((const char*)found - (const char*)data) : limit;
+  }
+#ifdef BLOX_SIMD_X86
+  if ((uintptr_t)data % width == 0) {
+    int avx2 = blox_cpu_avx2_();
+    switch (width) {
+      case 2:
+        return avx2 ? blox_string_length_avx2_16_(data, width, limit)
+                    : blox_string_length_sse2_16_(data, width, limit);
+      case 4:
+        return avx2 ? blox_string_length_avx2_32_(data, width, limit)
+                    : blox_string_length_sse2_32_(data, width, limit);
+      case 8:
+        return avx2 ? blox_string_length_avx2_64_(data, width, limit)
+                    : blox_string_length_sse2_64_(data, width, limit);
+    }
+  }
+#endif
+  return blox_string_length_scalar_(data, width, limit);
+}
+
+#define blox_string_length(TYPE, string) \
+  blox_string_length_(string, sizeof(TYPE), (size_t)-1)
+
+blox blox_use_string_(size_t width, const void* data, size_t limit) {
+  size_t length = blox_string_length_(data, width, limit);
+  blox buffer = {(void*)data, length, length, blox_borrowed_heap()};
   return buffer;
 }
 
@@ -435,19 +1110,820 @@ void* blox_find_(void* key,
                   (blox_comparison)comparison))
 
 /*
- FIXME: Not entirely rigorous
+ Typed linear scans for scalar element types (1, 2, 4 or 8 bytes wide).
+ Integers compare bitwise, floating point values compare with `==`.
 */
-int blox_compare_(void* lhs, size_t lmx, void* rhs, size_t rmx, size_t width) {
-  if (lmx != rmx)
-    return lmx < rmx ? -1 : 1;
-  return memcmp(lhs, rhs, lmx * width);
+
+enum { BLOX_SCAN_FIND, BLOX_SCAN_LAST, BLOX_SCAN_COUNT };
+
+#define blox__floating(TYPE) ((TYPE)0.5 != (TYPE)0)
+
+/*
+ How the bytes of a scalar element are to be interpreted when ordering
+ (BLOX_KEY_BYTES orders by raw memory contents instead)
+*/
+enum { BLOX_KEY_UNSIGNED, BLOX_KEY_SIGNED, BLOX_KEY_FLOATING, BLOX_KEY_BYTES };
+
+#define blox__key_kind(TYPE)                                   \
+  (blox__floating(TYPE)                                        \
+       ? BLOX_KEY_FLOATING                                     \
+       : ((TYPE)-1 < (TYPE)0 ? BLOX_KEY_SIGNED : BLOX_KEY_UNSIGNED))
+
+#define BLOX__SCAN_SCALAR(TYPE)                                  \
+  do {                                                           \
+    TYPE needle;                                                 \
+    memcpy(&needle, key, sizeof(TYPE));                          \
+    const TYPE* elements = (const TYPE*)data;                    \
+    if (mode == BLOX_SCAN_LAST) {                                \
+      for (size_t index = length; index--;)                      \
+        if (elements[index] == needle)                           \
+          return index;                                          \
+      return length;                                             \
+    }                                                            \
+    for (size_t index = 0; index < length; ++index)              \
+      if (elements[index] == needle) {                           \
+        if (mode == BLOX_SCAN_FIND)                              \
+          return index;                                          \
+        ++total;                                                 \
+      }                                                          \
+    return mode == BLOX_SCAN_FIND ? length : total;              \
+  } while (0)
+
+/*
+ Returns the index of the first (or last) match, or `length` if there is
+ none; in counting mode returns the number of matches
+*/
+size_t blox_scan_scalar_(const void* data,
+                         size_t length,
+                         size_t width,
+                         int floating,
+                         const void* key,
+                         int mode) {
+  size_t total = 0;
+  if (floating && width == sizeof(float))
+    BLOX__SCAN_SCALAR(float);
+  if (floating && width == sizeof(double))
+    BLOX__SCAN_SCALAR(double);
+  switch (width) {
+    case 1:
+      BLOX__SCAN_SCALAR(uint8_t);
+    case 2:
+      BLOX__SCAN_SCALAR(uint16_t);
+    case 4:
+      BLOX__SCAN_SCALAR(uint32_t);
+    case 8:
+      BLOX__SCAN_SCALAR(uint64_t);
+  }
+  typedef unsigned char byte;
+  const byte* current = (const byte*)data;
+  if (mode == BLOX_SCAN_LAST) {
+    for (size_t index = length; index--;)
+      if (memcmp(current + index * width, key, width) == 0)
+        return index;
+    return length;
+  }
+  for (size_t index = 0; index < length; ++index, current += width)
+    if (memcmp(current, key, width) == 0) {
+      if (mode == BLOX_SCAN_FIND)
+        return index;
+      ++total;
+    }
+  return mode == BLOX_SCAN_FIND ? length : total;
+}
+
+#ifdef BLOX_SIMD_X86
+
+/*
+ Stamps out a vector kernel; EQUAL must set every byte of a matching lane,
+ so that the byte mask can be converted back to element indices (ELEMENT
+ is the pointer type LOAD expects)
+*/
+#define BLOX__SCAN_KERNEL(NAME, FEATURES, VECTOR, ELEMENT, LOAD, MASK, NEEDLE, \
+                          EQUAL, FLOATING)                                     \
+  BLOX_TARGET(FEATURES)                                                        \
+  size_t NAME(const void* data, size_t length, size_t width, const void* key,  \
+              int mode) {                                                      \
+    typedef unsigned char byte;                                                \
+    const byte* bytes = (const byte*)data;                                     \
+    size_t size = length * width;                                              \
+    size_t step = sizeof(VECTOR);                                              \
+    size_t blocks = size - size % step;                                        \
+    size_t rest = (size - blocks) / width;                                     \
+    VECTOR needle = NEEDLE;                                                    \
+    size_t total = 0;                                                          \
+    if (mode == BLOX_SCAN_LAST) {                                              \
+      size_t found = blox_scan_scalar_(bytes + blocks, rest, width, FLOATING,  \
+                                       key, mode);                             \
+      if (found != rest)                                                       \
+        return blocks / width + found;                                         \
+      for (size_t offset = blocks; offset;) {                                  \
+        offset -= step;                                                        \
+        VECTOR block = LOAD((const ELEMENT*)(bytes + offset));                 \
+        uint64_t mask = (uint32_t)MASK(EQUAL);                                 \
+        if (mask)                                                              \
+          return (offset + 63 - blox_clz_(mask)) / width;                      \
+      }                                                                        \
+      return length;                                                           \
+    }                                                                          \
+    for (size_t offset = 0; offset < blocks; offset += step) {                 \
+      VECTOR block = LOAD((const ELEMENT*)(bytes + offset));                   \
+      uint64_t mask = (uint32_t)MASK(EQUAL);                                   \
+      if (mask) {                                                              \
+        if (mode == BLOX_SCAN_FIND)                                            \
+          return (offset + blox_ctz_(mask)) / width;                           \
+        total += blox_popcount_(mask);                                         \
+      }                                                                        \
+    }                                                                          \
+    size_t found =                                                             \
+        blox_scan_scalar_(bytes + blocks, rest, width, FLOATING, key, mode);   \
+    return mode == BLOX_SCAN_FIND ? blocks / width + found                     \
+                                  : total / width + found;                     \
+  }
+
+#define blox__load32(key) (*(const int32_t*)(key))
+#define blox__load64(key) (*(const int64_t*)(key))
+
+BLOX__SCAN_KERNEL(blox_scan_sse2_8_, "sse2", __m128i, __m128i,
+                  _mm_loadu_si128, _mm_movemask_epi8,
+                  _mm_set1_epi8(*(const char*)key),
+                  _mm_cmpeq_epi8(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_sse2_16_, "sse2", __m128i, __m128i,
+                  _mm_loadu_si128, _mm_movemask_epi8,
+                  _mm_set1_epi16(*(const short*)key),
+                  _mm_cmpeq_epi16(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_sse2_32_, "sse2", __m128i, __m128i,
+                  _mm_loadu_si128, _mm_movemask_epi8,
+                  _mm_set1_epi32(blox__load32(key)),
+                  _mm_cmpeq_epi32(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_sse2_64_, "sse2", __m128i, __m128i,
+                  _mm_loadu_si128, _mm_movemask_epi8,
+                  _mm_set1_epi64x(blox__load64(key)),
+                  _mm_and_si128(_mm_cmpeq_epi32(block, needle),
+                                _mm_shuffle_epi32(
+                                    _mm_cmpeq_epi32(block, needle), 0xB1)),
+                  0)
+BLOX__SCAN_KERNEL(blox_scan_sse2_float_, "sse2", __m128, float,
+                  _mm_loadu_ps, _mm_movemask_epi8,
+                  _mm_set1_ps(*(const float*)key),
+                  _mm_castps_si128(_mm_cmpeq_ps(block, needle)), 1)
+BLOX__SCAN_KERNEL(blox_scan_sse2_double_, "sse2", __m128d, double,
+                  _mm_loadu_pd, _mm_movemask_epi8,
+                  _mm_set1_pd(*(const double*)key),
+                  _mm_castpd_si128(_mm_cmpeq_pd(block, needle)), 1)
+
+BLOX__SCAN_KERNEL(blox_scan_avx2_8_, "avx2", __m256i, __m256i,
+                  _mm256_loadu_si256, _mm256_movemask_epi8,
+                  _mm256_set1_epi8(*(const char*)key),
+                  _mm256_cmpeq_epi8(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_avx2_16_, "avx2", __m256i, __m256i,
+                  _mm256_loadu_si256, _mm256_movemask_epi8,
+                  _mm256_set1_epi16(*(const short*)key),
+                  _mm256_cmpeq_epi16(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_avx2_32_, "avx2", __m256i, __m256i,
+                  _mm256_loadu_si256, _mm256_movemask_epi8,
+                  _mm256_set1_epi32(blox__load32(key)),
+                  _mm256_cmpeq_epi32(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_avx2_64_, "avx2", __m256i, __m256i,
+                  _mm256_loadu_si256, _mm256_movemask_epi8,
+                  _mm256_set1_epi64x(blox__load64(key)),
+                  _mm256_cmpeq_epi64(block, needle), 0)
+BLOX__SCAN_KERNEL(blox_scan_avx2_float_, "avx2", __m256, float,
+                  _mm256_loadu_ps, _mm256_movemask_epi8,
+                  _mm256_set1_ps(*(const float*)key),
+                  _mm256_castps_si256(_mm256_cmp_ps(block, needle, _CMP_EQ_OQ)),
+                  1)
+BLOX__SCAN_KERNEL(blox_scan_avx2_double_, "avx2", __m256d, double,
+                  _mm256_loadu_pd, _mm256_movemask_epi8,
+                  _mm256_set1_pd(*(const double*)key),
+                  _mm256_castpd_si256(_mm256_cmp_pd(block, needle, _CMP_EQ_OQ)),
+                  1)
+
+#endif  // BLOX_SIMD_X86
+
+typedef size_t (*blox_scan_kernel)(const void*, size_t, size_t, const void*, int);
+
+/*
+ Picks the widest kernel supported by the CPU (NULL means scalar)
+*/
+blox_scan_kernel blox_scan_kernel_(size_t width, int floating) {
+#ifdef BLOX_SIMD_X86
+  int avx2 = blox_cpu_avx2_();
+  if (floating)
+    switch (width) {
+      case 4:
+        return avx2 ? blox_scan_avx2_float_ : blox_scan_sse2_float_;
+      case 8:
+        return avx2 ? blox_scan_avx2_double_ : blox_scan_sse2_double_;
+      default:
+        return NULL;
+    }
+  switch (width) {
+    case 1:
+      return avx2 ? blox_scan_avx2_8_ : blox_scan_sse2_8_;
+    case 2:
+      return avx2 ? blox_scan_avx2_16_ : blox_scan_sse2_16_;
+    case 4:
+      return avx2 ? blox_scan_avx2_32_ : blox_scan_sse2_32_;
+    case 8:
+      return avx2 ? blox_scan_avx2_64_ : blox_scan_sse2_64_;
+  }
+#endif
+  return NULL;
+}
+
+size_t blox_scan_(const void* data,
+                  size_t length,
+                  size_t width,
+                  int floating,
+                  const void* key,
+                  int mode) {
+  blox_scan_kernel kernel = blox_scan_kernel_(width, floating);
+  if (kernel)
+    return kernel(data, length, width, key, mode);
+  return blox_scan_scalar_(data, length, width, floating, key, mode);
+}
+
+void* blox_find_value_(const void* data,
+                       size_t length,
+                       size_t width,
+                       int floating,
+                       const void* key,
+                       int mode) {
+  size_t index = blox_scan_(data, length, width, floating, key, mode);
+  if (index == length)
+    return NULL;
+  return (unsigned char*)data + index * width;
+}
+
+#define blox_find_value(TYPE, buffer, value)                                   \
+  ((TYPE*)blox_find_value_((buffer).data, (buffer).length, sizeof(TYPE),       \
+                           blox__floating(TYPE), BLOX__TEMPORARY(TYPE, value), \
+                           BLOX_SCAN_FIND))
+
+#define blox_find_last_value(TYPE, buffer, value)                              \
+  ((TYPE*)blox_find_value_((buffer).data, (buffer).length, sizeof(TYPE),       \
+                           blox__floating(TYPE), BLOX__TEMPORARY(TYPE, value), \
+                           BLOX_SCAN_LAST))
+
+#define blox_count_value(TYPE, buffer, value)                    \
+  blox_scan_((buffer).data, (buffer).length, sizeof(TYPE),       \
+             blox__floating(TYPE), BLOX__TEMPORARY(TYPE, value), \
+             BLOX_SCAN_COUNT)
+
+typedef int (*blox_predicate)(const void* element, void* userdata);
+
+void blox_truncate_(blox* buffer, size_t width, size_t length) {
+  buffer->length = length;
+  if (buffer->data != NULL)
+    memset((unsigned char*)buffer->data + length * width, 0, width);
+}
+
+/*
+ Removes every element for which `predicate` returns nonzero in a single
+ pass. The stable mode moves each run of kept elements once; the unstable
+ one fills every hole with the last element instead. Returns the number
+ of elements removed.
+*/
+size_t blox_remove_if_(blox* buffer,
+                       size_t width,
+                       blox_predicate predicate,
+                       void* userdata,
+                       int stable) {
+  typedef unsigned char byte;
+  byte* data = (byte*)buffer->data;
+  size_t length = buffer->length;
+  size_t kept = 0;
+  if (!stable) {
+    for (size_t index = 0; index < length;)
+      if (predicate(data + index * width, userdata)) {
+        if (index != --length) {
+          BLOX__STAT(MOVED, width);
+          memcpy(data + index * width, data + length * width, width);
+        }
+      } else
+        ++index;
+    kept = length;
+    length = buffer->length;
+  } else {
+    size_t run = 0;
+    for (size_t index = 0; index < length; ++index)
+      if (predicate(data + index * width, userdata)) {
+        if (run != kept) {
+          BLOX__STAT(MOVED, (index - run) * width);
+          memmove(data + kept * width, data + run * width,
+                  (index - run) * width);
+        }
+        kept += index - run;
+        run = index + 1;
+      }
+    if (run != kept) {
+      BLOX__STAT(MOVED, (length - run) * width);
+      memmove(data + kept * width, data + run * width, (length - run) * width);
+    }
+    kept += length - run;
+  }
+  blox_truncate_(buffer, width, kept);
+  return length - kept;
+}
+
+#define blox_remove_if(TYPE, buffer, predicate, userdata) \
+  BLOX__SITED(blox_remove_if_(&(buffer), sizeof(TYPE),    \
+                              (blox_predicate)(predicate), userdata, 1))
+
+#define blox_remove_if_unstable(TYPE, buffer, predicate, userdata) \
+  BLOX__SITED(blox_remove_if_(&(buffer), sizeof(TYPE),             \
+                              (blox_predicate)(predicate), userdata, 0))
+
+/*
+ Erases the elements at the given (ascending) indices in a single pass;
+ duplicate and out of range indices are ignored
+*/
+size_t blox_erase_indices_(blox* buffer,
+                           size_t width,
+                           const size_t* indices,
+                           size_t count,
+                           int stable) {
+  typedef unsigned char byte;
+  byte* data = (byte*)buffer->data;
+  size_t length = buffer->length;
+  size_t kept = 0;
+  if (!stable) {
+    size_t last = length;
+    while (count--) {
+      size_t index = indices[count];
+      if (index >= length || index == last)
+        continue;
+      if (index != --length) {
+        BLOX__STAT(MOVED, width);
+        memcpy(data + index * width, data + length * width, width);
+      }
+      last = index;
+    }
+    kept = length;
+    length = buffer->length;
+  } else {
+    size_t run = 0;
+    for (size_t next = 0; next < count; ++next) {
+      size_t index = indices[next];
+      if (index >= length || index < run)
+        continue;
+      if (run != kept) {
+        BLOX__STAT(MOVED, (index - run) * width);
+        memmove(data + kept * width, data + run * width,
+                (index - run) * width);
+      }
+      kept += index - run;
+      run = index + 1;
+    }
+    if (run != kept) {
+      BLOX__STAT(MOVED, (length - run) * width);
+      memmove(data + kept * width, data + run * width, (length - run) * width);
+    }
+    kept += length - run;
+  }
+  blox_truncate_(buffer, width, kept);
+  return length - kept;
+}
+
+#define blox_erase_indices(TYPE, buffer, indices)                \
+  BLOX__SITED(blox_erase_indices_(&(buffer), sizeof(TYPE),       \
+                                  (const size_t*)(indices).data, \
+                                  (indices).length, 1))
+
+#define blox_erase_indices_unstable(TYPE, buffer, indices)       \
+  BLOX__SITED(blox_erase_indices_(&(buffer), sizeof(TYPE),       \
+                                  (const size_t*)(indices).data, \
+                                  (indices).length, 0))
+
+/*
+ Branch-free compaction (the store is unconditional, only the cursor
+ moves), which compilers can vectorize
+*/
+#define BLOX__REMOVE_SCALAR(TYPE)                             \
+  do {                                                        \
+    TYPE* items = (TYPE*)data;                                \
+    TYPE needle = *(const TYPE*)key;                          \
+    for (size_t index = first + 1; index < length; ++index) { \
+      TYPE item = items[index];                               \
+      items[kept] = item;                                     \
+      kept += !(item == needle);                              \
+    }                                                         \
+    return kept;                                              \
+  } while (0)
+
+size_t blox_compact_value_(void* data,
+                           size_t length,
+                           size_t width,
+                           int floating,
+                           const void* key,
+                           size_t first) {
+  size_t kept = first;
+  if (floating && width == sizeof(float))
+    BLOX__REMOVE_SCALAR(float);
+  if (floating && width == sizeof(double))
+    BLOX__REMOVE_SCALAR(double);
+  switch (width) {
+    case 1:
+      BLOX__REMOVE_SCALAR(uint8_t);
+    case 2:
+      BLOX__REMOVE_SCALAR(uint16_t);
+    case 4:
+      BLOX__REMOVE_SCALAR(uint32_t);
+    case 8:
+      BLOX__REMOVE_SCALAR(uint64_t);
+  }
+  typedef unsigned char byte;
+  byte* items = (byte*)data;
+  for (size_t index = first + 1; index < length; ++index)
+    if (memcmp(items + index * width, key, width) != 0)
+      memcpy(items + kept++ * width, items + index * width, width);
+  return kept;
+}
+
+/*
+ Stable removal of all elements equal to `key`: everything before the
+ first match is skipped with the vectorized scan, the rest is compacted
+*/
+size_t blox_remove_value_(blox* buffer,
+                          size_t width,
+                          int floating,
+                          const void* key) {
+  size_t length = buffer->length;
+  size_t first = blox_scan_(buffer->data, length, width, floating, key,
+                            BLOX_SCAN_FIND);
+  if (first == length)
+    return 0;
+  BLOX__STAT(MOVED, (length - first - 1) * width);
+  size_t kept = blox_compact_value_(buffer->data, length, width, floating,
+                                    key, first);
+  blox_truncate_(buffer, width, kept);
+  return length - kept;
+}
+
+#define blox_remove_value(TYPE, buffer, value)            \
+  BLOX__SITED(blox_remove_value_(&(buffer), sizeof(TYPE), \
+                                 blox__floating(TYPE),    \
+                                 BLOX__TEMPORARY(TYPE, value)))
+
+/*
+ Offset of the first byte at which two regions differ (or `size`), a word
+ at a time
+*/
+size_t blox_mismatch_bytes_(const void* lhs, const void* rhs, size_t size) {
+  typedef unsigned char byte;
+  const byte* left = (const byte*)lhs;
+  const byte* right = (const byte*)rhs;
+  size_t offset = 0;
+  for (; offset + 8 <= size; offset += 8) {
+    uint64_t lword, rword;
+    memcpy(&lword, left + offset, 8);
+    memcpy(&rword, right + offset, 8);
+    if (lword != rword)
+      break;
+  }
+  while (offset < size && left[offset] == right[offset])
+    ++offset;
+  return offset;
+}
+
+#ifdef BLOX_SIMD_X86
+
+#define BLOX__MISMATCH_KERNEL(NAME, FEATURES, VECTOR, LOAD, MASK, EQUAL) \
+  BLOX_TARGET(FEATURES)                                                  \
+  size_t NAME(const void* lhs, const void* rhs, size_t size) {           \
+    typedef unsigned char byte;                                          \
+    const byte* left = (const byte*)lhs;                                 \
+    const byte* right = (const byte*)rhs;                                \
+    uint32_t full = (uint32_t)(((uint64_t)1 << sizeof(VECTOR)) - 1);     \
+    size_t offset = 0;                                                   \
+    for (; offset + sizeof(VECTOR) <= size; offset += sizeof(VECTOR)) {  \
+      uint32_t mask =                                                    \
+          (uint32_t)MASK(EQUAL(LOAD((const VECTOR*)(left + offset)),     \
+                               LOAD((const VECTOR*)(right + offset))));  \
+      if (mask != full)                                                  \
+        return offset + blox_ctz_(~mask & full);                         \
+    }                                                                    \
+    return offset + blox_mismatch_bytes_(left + offset, right + offset,  \
+                                         size - offset);                 \
+  }
+
+BLOX__MISMATCH_KERNEL(blox_mismatch_sse2_, "sse2", __m128i, _mm_loadu_si128,
+                      _mm_movemask_epi8, _mm_cmpeq_epi8)
+BLOX__MISMATCH_KERNEL(blox_mismatch_avx2_, "avx2", __m256i,
+                      _mm256_loadu_si256, _mm256_movemask_epi8,
+                      _mm256_cmpeq_epi8)
+
+#endif  // BLOX_SIMD_X86
+
+/*
+ Index of the first of `length` elements that differ (bitwise) between
+ `lhs` and `rhs`, or `length` if there is none
+*/
+size_t blox_mismatch_(const void* lhs,
+                      const void* rhs,
+                      size_t length,
+                      size_t width) {
+  size_t size = length * width;
+#ifdef BLOX_SIMD_X86
+  if (size >= 16)
+    size = blox_cpu_avx2_() ? blox_mismatch_avx2_(lhs, rhs, size)
+                            : blox_mismatch_sse2_(lhs, rhs, size);
+  else
+#endif
+    size = blox_mismatch_bytes_(lhs, rhs, size);
+  return size / width;
+}
+
+#define blox_mismatch(TYPE, lbx, rbx)                            \
+  blox_mismatch_(                                                \
+      (lbx).data, (rbx).data,                                    \
+      (lbx).length < (rbx).length ? (lbx).length : (rbx).length, \
+      sizeof(TYPE))
+
+/*
+ Maps a 1, 2, 4 or 8 byte scalar to an unsigned integer with the same
+ order. Floating point values are ordered as by IEEE 754 totalOrder
+ (-0.0 before 0.0, NaNs at either end by sign), so two keys are equal
+ exactly when their bits are.
+*/
+uint64_t blox_order_key_(const void* element, size_t width, int kind) {
+  uint64_t key = 0;
+  switch (width) {
+    case 1: {
+      uint8_t value;
+      memcpy(&value, element, 1);
+      key = value;
+    } break;
+    case 2: {
+      uint16_t value;
+      memcpy(&value, element, 2);
+      key = value;
+    } break;
+    case 4: {
+      uint32_t value;
+      memcpy(&value, element, 4);
+      key = value;
+    } break;
+    default:
+      memcpy(&key, element, 8);
+  }
+  uint64_t sign = (uint64_t)1 << (width * 8 - 1);
+  if (kind == BLOX_KEY_SIGNED)
+    key ^= sign;
+  else if (kind == BLOX_KEY_FLOATING)
+    key = (key & sign) ? (~key & (sign | (sign - 1))) : (key | sign);
+  return key;
+}
+
+int blox_order_element_(const void* lhs,
+                        const void* rhs,
+                        size_t width,
+                        int kind) {
+  if (kind != BLOX_KEY_BYTES &&
+      (width == 1 || width == 2 || width == 4 || width == 8)) {
+    uint64_t left = blox_order_key_(lhs, width, kind);
+    uint64_t right = blox_order_key_(rhs, width, kind);
+    return (left > right) - (left < right);
+  }
+  int order = memcmp(lhs, rhs, width);
+  return (order > 0) - (order < 0);
+}
+
+/*
+ Lexicographic comparison: elements are compared in turn (as values of
+ the given kind) and a container that is a prefix of the other orders
+ first. Skips ahead with `blox_mismatch_`, so only elements whose bits
+ differ are ever looked at individually.
+*/
+int blox_compare_(const void* lhs,
+                  size_t lmx,
+                  const void* rhs,
+                  size_t rmx,
+                  size_t width,
+                  int kind) {
+  typedef unsigned char byte;
+  size_t shared = lmx < rmx ? lmx : rmx;
+  size_t index = 0;
+  while (index < shared) {
+    const byte* left = (const byte*)lhs + index * width;
+    const byte* right = (const byte*)rhs + index * width;
+    index += blox_mismatch_(left, right, shared - index, width);
+    if (index == shared)
+      break;
+    int order = blox_order_element_((const byte*)lhs + index * width,
+                                    (const byte*)rhs + index * width, width,
+                                    kind);
+    if (order != 0)
+      return order;
+    ++index;
+  }
+  return (lmx > rmx) - (lmx < rmx);
 }
 
 #define blox_compare(TYPE, lbx, rbx)                                \
   blox_compare_((lbx).data, (lbx).length, (rbx).data, (rbx).length, \
-                sizeof(TYPE))
+                sizeof(TYPE), BLOX_KEY_BYTES)
+
+#define blox_compare_values(TYPE, lbx, rbx)                         \
+  blox_compare_((lbx).data, (lbx).length, (rbx).data, (rbx).length, \
+                sizeof(TYPE), blox__key_kind(TYPE))
+
+int blox_equal_(const void* lhs,
+                size_t lmx,
+                const void* rhs,
+                size_t rmx,
+                size_t width) {
+  return lmx == rmx && blox_mismatch_(lhs, rhs, lmx, width) == lmx;
+}
+
+#define blox_equal(TYPE, lbx, rbx)                                \
+  blox_equal_((lbx).data, (lbx).length, (rbx).data, (rbx).length, \
+              sizeof(TYPE))
+
+/*
+ Content hashing: short inputs go through a multiply-fold mix (as in
+ wyhash), long ones are first reduced by four 64-bit accumulators over
+ 32 byte stripes (as in XXH3), with an AVX2 version of the stripe loop.
+ Both versions produce the same hashes.
+*/
+
+#define BLOX__HASH_S0 0xA0761D6478BD642FULL
+#define BLOX__HASH_S1 0xE7037ED1A0B428DBULL
+#define BLOX__HASH_S2 0x8EBC6AF09C88C6E3ULL
+#define BLOX__HASH_S3 0x589965CC75374CC3ULL
+#define BLOX__HASH_S4 0x1D8E4E27C47D124FULL
+#define BLOX__HASH_S5 0x9E3779B97F4A7C15ULL
+#define BLOX__HASH_S6 0xC2B2AE3D27D4EB4FULL
+#define BLOX__HASH_S7 0x165667B19E3779F9ULL
+#define BLOX__HASH_PRIME 0x9E3779B1ULL
+
+#ifndef BLOX_HASH_STRIPED
+#define BLOX_HASH_STRIPED 256
+#endif
+
+/*
+ Folds the 128-bit product of two words into one
+*/
+uint64_t blox_mum_(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = (__uint128_t)lhs * rhs;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t high;
+  uint64_t low = _umul128(lhs, rhs, &high);
+  return low ^ high;
+#else
+  uint64_t lhs_high = lhs >> 32, lhs_low = (uint32_t)lhs;
+  uint64_t rhs_high = rhs >> 32, rhs_low = (uint32_t)rhs;
+  uint64_t cross = (lhs_low * rhs_low >> 32) + (uint32_t)(lhs_high * rhs_low) +
+                   lhs_low * rhs_high;
+  uint64_t high = lhs_high * rhs_high + (lhs_high * rhs_low >> 32) +
+                  (cross >> 32);
+  return (lhs * rhs) ^ high;
+#endif
+}
+
+uint64_t blox_read64_(const unsigned char* data) {
+  uint64_t value;
+  memcpy(&value, data, 8);
+  return value;
+}
+
+uint64_t blox_read32_(const unsigned char* data) {
+  uint32_t value;
+  memcpy(&value, data, 4);
+  return value;
+}
+
+/*
+ Accumulates `stripes` 32 byte stripes into `accumulators`, scrambling
+ them every 16 stripes
+*/
+void blox_hash_stripes_scalar_(uint64_t* accumulators,
+                               const unsigned char* data,
+                               size_t stripes) {
+  const uint64_t secret[8] = {BLOX__HASH_S0, BLOX__HASH_S1, BLOX__HASH_S2,
+                              BLOX__HASH_S3, BLOX__HASH_S4, BLOX__HASH_S5,
+                              BLOX__HASH_S6, BLOX__HASH_S7};
+  for (size_t stripe = 0; stripe < stripes; ++stripe, data += 32) {
+    for (int lane = 0; lane < 4; ++lane) {
+      uint64_t value = blox_read64_(data + lane * 8);
+      uint64_t key = value ^ secret[lane];
+      accumulators[lane ^ 1] += value;
+      accumulators[lane] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+    if (stripe % 16 == 15)
+      for (int lane = 0; lane < 4; ++lane) {
+        uint64_t value = accumulators[lane];
+        value ^= (value >> 47) ^ secret[lane + 4];
+        accumulators[lane] = value * BLOX__HASH_PRIME;
+      }
+  }
+}
+
+#ifdef BLOX_SIMD_X86
+
+BLOX_TARGET("avx2")
+void blox_hash_stripes_avx2_(uint64_t* accumulators,
+                             const unsigned char* data,
+                             size_t stripes) {
+  __m256i sums = _mm256_loadu_si256((const __m256i*)accumulators);
+  __m256i secret = _mm256_set_epi64x(BLOX__HASH_S3, BLOX__HASH_S2,
+                                     BLOX__HASH_S1, BLOX__HASH_S0);
+  __m256i scramble = _mm256_set_epi64x(BLOX__HASH_S7, BLOX__HASH_S6,
+                                       BLOX__HASH_S5, BLOX__HASH_S4);
+  __m256i prime = _mm256_set1_epi64x(BLOX__HASH_PRIME);
+  for (size_t stripe = 0; stripe < stripes; ++stripe, data += 32) {
+    __m256i value = _mm256_loadu_si256((const __m256i*)data);
+    __m256i key = _mm256_xor_si256(value, secret);
+    __m256i product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+    __m256i swapped = _mm256_shuffle_epi32(value, 0x4E);
+    sums = _mm256_add_epi64(sums, _mm256_add_epi64(product, swapped));
+    if (stripe % 16 == 15) {
+      sums = _mm256_xor_si256(sums, _mm256_srli_epi64(sums, 47));
+      sums = _mm256_xor_si256(sums, scramble);
+      __m256i low = _mm256_mul_epu32(sums, prime);
+      __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(sums, 32), prime);
+      sums = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+  }
+  _mm256_storeu_si256((__m256i*)accumulators, sums);
+}
+
+#endif  // BLOX_SIMD_X86
+
+uint64_t blox_content_hash_(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* current = (const unsigned char*)data;
+  size_t left = size;
+  seed ^= blox_mum_(seed ^ BLOX__HASH_S0, BLOX__HASH_S1);
+  if (left > BLOX_HASH_STRIPED) {
+    uint64_t accumulators[4] = {BLOX__HASH_S0 ^ seed, BLOX__HASH_S1,
+                                BLOX__HASH_S2 ^ seed, BLOX__HASH_S3};
+    size_t stripes = left / 32;
+#ifdef BLOX_SIMD_X86
+    if (blox_cpu_avx2_())
+      blox_hash_stripes_avx2_(accumulators, current, stripes);
+    else
+#endif
+      blox_hash_stripes_scalar_(accumulators, current, stripes);
+    seed = blox_mum_(accumulators[0] ^ BLOX__HASH_S0, accumulators[1] ^ seed);
+    seed = blox_mum_(accumulators[2] ^ BLOX__HASH_S2, accumulators[3] ^ seed);
+    current += stripes * 32;
+    left -= stripes * 32;
+  }
+  while (left > 16) {
+    seed = blox_mum_(blox_read64_(current) ^ BLOX__HASH_S1,
+                     blox_read64_(current + 8) ^ seed);
+    current += 16;
+    left -= 16;
+  }
+  uint64_t first = 0, second = 0;
+  if (left >= 4) {
+    size_t step = (left >> 3) << 2;
+    first = (blox_read32_(current) << 32) | blox_read32_(current + step);
+    second = (blox_read32_(current + left - 4) << 32) |
+             blox_read32_(current + left - 4 - step);
+  } else if (left > 0)
+    first = ((uint64_t)current[0] << 16) |
+            ((uint64_t)current[left >> 1] << 8) | current[left - 1];
+  return blox_mum_(BLOX__HASH_S1 ^ size,
+                   blox_mum_(first ^ BLOX__HASH_S1, second ^ seed));
+}
+
+#define blox_content_hash(TYPE, buffer) \
+  blox_content_hash_((buffer).data, (buffer).length * sizeof(TYPE), 0)
+
+/*
+ A view paired with the hash of its contents, computed once so that
+ repeated lookups with the same key don't rescan it. The viewed data must
+ not change (or go away) while the key is in use.
+*/
+typedef struct {
+  blox view;
+  size_t width;
+  uint64_t hash;
+} blox_key;
+
+blox_key blox_key_(const void* data, size_t length, size_t width) {
+  blox_key key;
+  key.view = blox_use_(data, length);
+  key.width = width;
+  key.hash = blox_content_hash_(data, length * width, 0);
+  return key;
+}
+
+#define blox_key_of(TYPE, buffer) \
+  blox_key_((buffer).data, (buffer).length, sizeof(TYPE))
+
+#define blox_key_hash(key) (key).hash
+
+int blox_key_equal_(const blox_key* lhs, const blox_key* rhs) {
+  return lhs->hash == rhs->hash && lhs->width == rhs->width &&
+         blox_equal_(lhs->view.data, lhs->view.length, rhs->view.data,
+                     rhs->view.length, lhs->width);
+}
 
-#define blox_equal(TYPE, lbx, rbx) (blox_compare(TYPE, lbx, rbx) == 0)
+#define blox_key_equal(lhs, rhs) blox_key_equal_(&(lhs), &(rhs))
 
 #define blox_less(TYPE, lbx, rbx) (blox_compare(TYPE, lbx, rbx) < 0)
 
@@ -0,0 +1,241 @@
+/* Blox Array Library - Aligned and Huge Page Heap
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_ALIGNED_H_INCLUDED
+#define BLOX_ALIGNED_H_INCLUDED
+
+#include <stdint.h>
+#include "blox.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifdef MAP_ANONYMOUS
+#define BLOX_ALIGNED_MAPS 1
+#endif
+#endif
+
+#ifndef BLOX_ALIGNMENT
+#define BLOX_ALIGNMENT 64
+#endif
+
+/*
+ Allocations of at least this many bytes get their own anonymous mapping
+*/
+#ifndef BLOX_HUGE_THRESHOLD
+#define BLOX_HUGE_THRESHOLD ((size_t)32 << 20)
+#endif
+
+/*
+ Heap whose allocations start at a multiple of `heap.alignment` bytes.
+ Small ones come from `blox_realloc` (over-allocated so they can be
+ aligned), while those of `threshold` bytes or more are mapped directly,
+ with transparent huge pages requested, and grown with `mremap` (where
+ available, which on glibc requires _GNU_SOURCE) so that the kernel moves
+ page tables rather than the elements. The heap must not be moved while
+ in use, as it refers to itself.
+*/
+typedef struct {
+  blox_heap heap;
+  size_t threshold;
+} blox_aligned;
+
+/*
+ Stored just in front of each allocation: where the underlying block
+ starts, and its length if it is a mapping (zero otherwise)
+*/
+typedef struct {
+  void* base;
+  size_t mapped;
+} blox_aligned_header_;
+
+#define blox_aligned__round(value, alignment) \
+  (((value) + ((alignment)-1)) & ~((size_t)(alignment)-1))
+
+#define blox_aligned__header(data) (((blox_aligned_header_*)(data)) - 1)
+
+size_t blox_aligned_alignment_(size_t alignment) {
+  if (alignment < sizeof(blox_aligned_header_))
+    return sizeof(blox_aligned_header_);
+  return alignment;
+}
+
+/*
+ First suitably aligned address in `base` that leaves room for the header
+*/
+unsigned char* blox_aligned_start_(void* base, size_t alignment) {
+  uintptr_t start = (uintptr_t)base + sizeof(blox_aligned_header_);
+  return (unsigned char*)blox_aligned__round(start, (uintptr_t)alignment);
+}
+
+unsigned char* blox_aligned_mark_(unsigned char* data,
+                                  void* base,
+                                  size_t mapped) {
+  blox_aligned__header(data)->base = base;
+  blox_aligned__header(data)->mapped = mapped;
+  return data;
+}
+
+#ifdef BLOX_ALIGNED_MAPS
+
+size_t blox_aligned_page_(void) {
+  static size_t page = 0;
+  if (page == 0)
+    page = (size_t)sysconf(_SC_PAGESIZE);
+  return page;
+}
+
+void* blox_aligned_map_(size_t size, size_t alignment) {
+  size_t length = blox_aligned__round(
+      size + alignment + sizeof(blox_aligned_header_), blox_aligned_page_());
+  void* base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+#ifdef MADV_HUGEPAGE
+  madvise(base, length, MADV_HUGEPAGE);
+#endif
+  return blox_aligned_mark_(blox_aligned_start_(base, alignment), base, length);
+}
+
+#endif
+
+void* blox_aligned_allocate_(void* context, size_t size, size_t alignment) {
+  blox_aligned* aligned = (blox_aligned*)context;
+  alignment = blox_aligned_alignment_(alignment);
+#ifdef BLOX_ALIGNED_MAPS
+  if (size >= aligned->threshold)
+    return blox_aligned_map_(size, alignment);
+#else
+  (void)aligned;
+#endif
+  void* base = blox_realloc(NULL)(
+      NULL, size + alignment + sizeof(blox_aligned_header_));
+  if (base == NULL)
+    return NULL;
+  return blox_aligned_mark_(blox_aligned_start_(base, alignment), base, 0);
+}
+
+void blox_aligned_release_(void* context, void* data) {
+  blox_aligned_header_* header = blox_aligned__header(data);
+  (void)context;
+#ifdef BLOX_ALIGNED_MAPS
+  if (header->mapped) {
+    munmap(header->base, header->mapped);
+    return;
+  }
+#endif
+  blox_realloc(NULL)(header->base, 0);
+}
+
+/*
+ Mappings are resized with `mremap` and small blocks with `blox_realloc`
+ (shifting the elements if the new block isn't aligned the same way);
+ crossing the threshold in either direction takes one copy
+*/
+void* blox_aligned_reallocate_(void* context,
+                               void* data,
+                               size_t size,
+                               size_t request,
+                               size_t alignment) {
+  typedef unsigned char byte;
+  blox_aligned* aligned = (blox_aligned*)context;
+  blox_aligned_header_* header = blox_aligned__header(data);
+  size_t offset = (byte*)data - (byte*)header->base;
+  size_t kept = size < request ? size : request;
+  alignment = blox_aligned_alignment_(alignment);
+#if defined(BLOX_ALIGNED_MAPS) && defined(MREMAP_MAYMOVE)
+  if (header->mapped && request >= aligned->threshold) {
+    size_t length = blox_aligned__round(request + alignment +
+                                            sizeof(blox_aligned_header_),
+                                        blox_aligned_page_());
+    void* base = mremap(header->base, header->mapped, length, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED)
+      return NULL;
+    byte* moved = (byte*)base + offset;
+    byte* placed = blox_aligned_start_(base, alignment);
+    if (placed != moved) {
+      memmove(placed, moved, kept);
+      BLOX__STAT(MOVED, kept);
+    }
+    return blox_aligned_mark_(placed, base, length);
+  }
+#endif
+  if (!header->mapped && request < aligned->threshold) {
+    void* base = blox_realloc(NULL)(
+        header->base, request + alignment + sizeof(blox_aligned_header_));
+    if (base == NULL)
+      return NULL;
+    byte* moved = (byte*)base + offset;
+    byte* placed = blox_aligned_start_(base, alignment);
+    if (placed != moved) {
+      memmove(placed, moved, kept);
+      BLOX__STAT(MOVED, kept);
+    }
+    return blox_aligned_mark_(placed, base, 0);
+  }
+  void* fresh = blox_aligned_allocate_(context, request, alignment);
+  if (fresh == NULL)
+    return NULL;
+  memcpy(fresh, data, kept);
+  BLOX__STAT(MOVED, kept);
+  blox_aligned_release_(context, data);
+  return fresh;
+}
+
+/*
+ Sets up a heap with the given alignment (a power of two, 0 meaning
+ BLOX_ALIGNMENT) which maps allocations of `threshold` bytes or more
+ (0 meaning BLOX_HUGE_THRESHOLD, and -1 never mapping anything)
+*/
+void blox_aligned_init(blox_aligned* aligned,
+                       size_t alignment,
+                       size_t threshold) {
+  aligned->heap.allocate = blox_aligned_allocate_;
+  aligned->heap.reallocate = blox_aligned_reallocate_;
+  aligned->heap.release = blox_aligned_release_;
+  aligned->heap.context = aligned;
+  aligned->heap.alignment = alignment ? alignment : BLOX_ALIGNMENT;
+  aligned->heap.growth = NULL;
+  aligned->threshold = threshold ? threshold : BLOX_HUGE_THRESHOLD;
+}
+
+#define blox_aligned_heap(aligned) (&(aligned)->heap)
+
+/*
+ Shared instance with the default alignment and threshold
+*/
+blox_heap* blox_huge_heap(void) {
+  static blox_aligned aligned = {
+      {blox_aligned_allocate_, blox_aligned_reallocate_, blox_aligned_release_,
+       &aligned, BLOX_ALIGNMENT, NULL},
+      BLOX_HUGE_THRESHOLD};
+  return &aligned.heap;
+}
+
+#endif  // BLOX_ALIGNED_H_INCLUDED
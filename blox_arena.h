@@ -0,0 +1,182 @@
+/* Blox Array Library - Arena Heap
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_ARENA_H_INCLUDED
+#define BLOX_ARENA_H_INCLUDED
+
+#include <stdint.h>
+#include "blox.h"
+
+#ifndef BLOX_ARENA_ALIGNMENT
+#define BLOX_ARENA_ALIGNMENT 16
+#endif
+
+typedef struct blox_arena_chunk_ {
+  struct blox_arena_chunk_* next;
+  size_t size;
+  size_t used;
+} blox_arena_chunk_;
+
+/*
+ Bump allocator: hands out regions from large chunks, grows the most
+ recent allocation in place and releases everything at once with
+ `blox_arena_reset`. Individual releases are no-ops (except for the most
+ recent allocation, which is simply rolled back).
+*/
+typedef struct {
+  blox_heap heap;
+  blox_arena_chunk_* chunks;
+  size_t chunk_size;
+  void* last;
+} blox_arena;
+
+#define blox_arena__round(value, alignment) \
+  (((value) + ((alignment)-1)) & ~((size_t)(alignment)-1))
+
+#define blox_arena__header \
+  blox_arena__round(sizeof(blox_arena_chunk_), BLOX_ARENA_ALIGNMENT)
+
+#define blox_arena__base(chunk) ((unsigned char*)(chunk) + blox_arena__header)
+
+size_t blox_arena_alignment_(size_t alignment) {
+  return alignment > BLOX_ARENA_ALIGNMENT ? alignment : BLOX_ARENA_ALIGNMENT;
+}
+
+blox_arena_chunk_* blox_arena_grab_(blox_arena* arena,
+                                    size_t size,
+                                    size_t alignment) {
+  size_t needed = size + alignment;
+  size_t room = arena->chunk_size > needed ? arena->chunk_size : needed;
+  blox_arena_chunk_* chunk =
+      (blox_arena_chunk_*)blox_realloc(NULL)(NULL, blox_arena__header + room);
+  if (chunk == NULL)
+    return NULL;
+  chunk->next = arena->chunks;
+  chunk->size = room;
+  chunk->used = 0;
+  arena->chunks = chunk;
+  return chunk;
+}
+
+void* blox_arena_bump_(blox_arena* arena, size_t size, size_t alignment) {
+  alignment = blox_arena_alignment_(alignment);
+  blox_arena_chunk_* chunk = arena->chunks;
+  size_t offset = 0;
+  if (chunk != NULL) {
+    uintptr_t cursor = (uintptr_t)(blox_arena__base(chunk) + chunk->used);
+    offset = chunk->used + (blox_arena__round(cursor, alignment) - cursor);
+  }
+  if (chunk == NULL || offset + size > chunk->size) {
+    chunk = blox_arena_grab_(arena, size, alignment);
+    if (chunk == NULL)
+      return NULL;
+    uintptr_t cursor = (uintptr_t)blox_arena__base(chunk);
+    offset = blox_arena__round(cursor, alignment) - cursor;
+  }
+  chunk->used = offset + size;
+  arena->last = blox_arena__base(chunk) + offset;
+  return arena->last;
+}
+
+void* blox_arena_allocate_(void* context, size_t size, size_t alignment) {
+  return blox_arena_bump_((blox_arena*)context, size, alignment);
+}
+
+void* blox_arena_reallocate_(void* context,
+                             void* data,
+                             size_t size,
+                             size_t request,
+                             size_t alignment) {
+  blox_arena* arena = (blox_arena*)context;
+  blox_arena_chunk_* chunk = arena->chunks;
+  if (request <= size && data != arena->last)
+    return data;
+  if (data == arena->last && chunk != NULL) {
+    size_t offset = (unsigned char*)data - blox_arena__base(chunk);
+    if (offset + request <= chunk->size) {
+      chunk->used = offset + request;
+      return data;
+    }
+  }
+  void* region = blox_arena_bump_(arena, request, alignment);
+  if (region != NULL)
+    memcpy(region, data, size < request ? size : request);
+  return region;
+}
+
+void blox_arena_release_(void* context, void* data) {
+  blox_arena* arena = (blox_arena*)context;
+  blox_arena_chunk_* chunk = arena->chunks;
+  if (data != arena->last || chunk == NULL)
+    return;
+  chunk->used = (unsigned char*)data - blox_arena__base(chunk);
+  arena->last = NULL;
+}
+
+/*
+ Sets up an arena that allocates in chunks of (at least) `chunk_size`
+ bytes; the arena must not be moved afterwards, as its heap refers to it
+*/
+void blox_arena_init(blox_arena* arena, size_t chunk_size) {
+  arena->heap.allocate = blox_arena_allocate_;
+  arena->heap.reallocate = blox_arena_reallocate_;
+  arena->heap.release = blox_arena_release_;
+  arena->heap.context = arena;
+  arena->heap.alignment = 0;
+  arena->heap.growth = NULL;
+  arena->chunks = NULL;
+  arena->chunk_size = chunk_size;
+  arena->last = NULL;
+}
+
+#define blox_arena_heap(arena) (&(arena)->heap)
+
+/*
+ Releases every allocation at once, keeping the most recently obtained
+ chunk around for reuse
+*/
+void blox_arena_reset(blox_arena* arena) {
+  blox_arena_chunk_* chunk = arena->chunks;
+  if (chunk == NULL)
+    return;
+  blox_arena_chunk_* next = chunk->next;
+  while (next != NULL) {
+    blox_arena_chunk_* stale = next;
+    next = next->next;
+    blox_realloc(NULL)(stale, 0);
+  }
+  chunk->next = NULL;
+  chunk->used = 0;
+  arena->last = NULL;
+}
+
+void blox_arena_free(blox_arena* arena) {
+  blox_arena_reset(arena);
+  if (arena->chunks != NULL)
+    blox_realloc(NULL)(arena->chunks, 0);
+  arena->chunks = NULL;
+}
+
+#endif  // BLOX_ARENA_H_INCLUDED
@@ -0,0 +1,358 @@
+/* Blox Array Library - Bit Sets
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_BITS_H_INCLUDED
+#define BLOX_BITS_H_INCLUDED
+
+#include "blox.h"
+
+/*
+ Packed bit set: `length` bits stored 64 to a word in `words`, which grows
+ through `blox_resize` (and therefore the container's heap and growth
+ policy). Bits past `length` are always zero.
+*/
+typedef struct {
+  blox words;
+  size_t length;
+} blox_bits;
+
+#define blox_bits__words(length) (((length) + 63) / 64)
+
+#define blox_bits__word(bits, index) \
+  blox_get(uint64_t, (bits).words, (index) / 64)
+
+#define blox_bits__mask(index) ((uint64_t)1 << ((index) % 64))
+
+#define blox_bits_length(bits) (bits).length
+
+#define blox_bits_empty(bits) (blox_bits_length(bits) == 0)
+
+#define blox_bits_test(bits, index) \
+  ((blox_bits__word(bits, index) & blox_bits__mask(index)) != 0)
+
+#define blox_bits_set(bits, index) \
+  (blox_bits__word(bits, index) |= blox_bits__mask(index))
+
+#define blox_bits_clear(bits, index) \
+  (blox_bits__word(bits, index) &= ~blox_bits__mask(index))
+
+#define blox_bits_flip(bits, index) \
+  (blox_bits__word(bits, index) ^= blox_bits__mask(index))
+
+#define blox_bits_assign(bits, index, value) \
+  ((value) ? blox_bits_set(bits, index) : blox_bits_clear(bits, index))
+
+/*
+ The words holding the bits, e.g. for `blox_io_write` (bits past the end
+ of the last word are zero)
+*/
+#define blox_bits_view(bits) \
+  blox_use((bits).words.data, (bits).words.length)
+
+/*
+ Zeroes the unused bits of the last word
+*/
+void blox_bits_trim_(blox_bits* bits) {
+  size_t used = bits->length % 64;
+  if (used != 0)
+    blox_get(uint64_t, bits->words, bits->length / 64) &=
+        ((uint64_t)1 << used) - 1;
+}
+
+/*
+ Sets the number of bits, new ones being zero; returns 0 if memory ran out
+*/
+int blox_bits_resize_(blox_bits* bits, size_t length) {
+  size_t count = blox_bits__words(length);
+  blox_resize(uint64_t, bits->words, count);
+  if (bits->words.length != count)
+    return 0;
+  bits->length = length;
+  blox_bits_trim_(bits);
+  return 1;
+}
+
+#define blox_bits_resize(bits, length) \
+  BLOX__SITED(blox_bits_resize_(&(bits), length))
+
+/*
+ Appends a bit; returns 0 if memory ran out
+*/
+int blox_bits_push_(blox_bits* bits, int value) {
+  size_t index = bits->length;
+  if (!blox_bits_resize_(bits, index + 1))
+    return 0;
+  if (value)
+    blox_bits_set(*bits, index);
+  return 1;
+}
+
+#define blox_bits_push(bits, value) \
+  BLOX__SITED(blox_bits_push_(&(bits), (value) != 0))
+
+/*
+ Sets (or clears) every bit
+*/
+void blox_bits_fill_(blox_bits* bits, int value) {
+  size_t count = bits->words.length;
+  if (count == 0)
+    return;
+  memset(bits->words.data, value ? 0xFF : 0, count * sizeof(uint64_t));
+  blox_bits_trim_(bits);
+}
+
+#define blox_bits_fill(bits, value) blox_bits_fill_(&(bits), value)
+
+enum { BLOX_BITS_AND, BLOX_BITS_OR, BLOX_BITS_XOR, BLOX_BITS_ANDNOT };
+
+#define BLOX__BITS_LOOP(EXPRESSION) \
+  for (; index < count; ++index) {  \
+    uint64_t lhs = target[index];   \
+    uint64_t rhs = source[index];   \
+    target[index] = (EXPRESSION);   \
+  }
+
+void blox_bits_combine_scalar_(uint64_t* target,
+                               const uint64_t* source,
+                               size_t count,
+                               int operation) {
+  size_t index = 0;
+  switch (operation) {
+    case BLOX_BITS_AND:
+      BLOX__BITS_LOOP(lhs & rhs);
+      break;
+    case BLOX_BITS_OR:
+      BLOX__BITS_LOOP(lhs | rhs);
+      break;
+    case BLOX_BITS_XOR:
+      BLOX__BITS_LOOP(lhs ^ rhs);
+      break;
+    default:
+      BLOX__BITS_LOOP(lhs & ~rhs);
+  }
+}
+
+#if defined(BLOX_SIMD_X86)
+
+BLOX_TARGET("avx2")
+void blox_bits_combine_avx2_(uint64_t* target,
+                             const uint64_t* source,
+                             size_t count,
+                             int operation) {
+  size_t index = 0;
+  for (; index + 4 <= count; index += 4) {
+    __m256i lhs = _mm256_loadu_si256((const __m256i*)(target + index));
+    __m256i rhs = _mm256_loadu_si256((const __m256i*)(source + index));
+    switch (operation) {
+      case BLOX_BITS_AND:
+        lhs = _mm256_and_si256(lhs, rhs);
+        break;
+      case BLOX_BITS_OR:
+        lhs = _mm256_or_si256(lhs, rhs);
+        break;
+      case BLOX_BITS_XOR:
+        lhs = _mm256_xor_si256(lhs, rhs);
+        break;
+      default:
+        lhs = _mm256_andnot_si256(rhs, lhs);
+    }
+    _mm256_storeu_si256((__m256i*)(target + index), lhs);
+  }
+  blox_bits_combine_scalar_(target + index, source + index, count - index,
+                            operation);
+}
+
+#endif
+
+/*
+ Applies `operation` in place, treating missing words of `source` as zero;
+ `target` keeps its length
+*/
+void blox_bits_combine_(blox_bits* target,
+                        const blox_bits* source,
+                        int operation) {
+  uint64_t* lhs = blox_data(uint64_t, target->words);
+  const uint64_t* rhs = blox_data(uint64_t, source->words);
+  size_t count = target->words.length;
+  size_t shared = count < source->words.length ? count : source->words.length;
+#if defined(BLOX_SIMD_X86)
+  if (blox_cpu_avx2_())
+    blox_bits_combine_avx2_(lhs, rhs, shared, operation);
+  else
+#endif
+    blox_bits_combine_scalar_(lhs, rhs, shared, operation);
+  if (operation == BLOX_BITS_AND && shared < count)
+    memset(lhs + shared, 0, (count - shared) * sizeof(uint64_t));
+  blox_bits_trim_(target);
+}
+
+#define blox_bits_and(target, source) \
+  blox_bits_combine_(&(target), &(source), BLOX_BITS_AND)
+
+#define blox_bits_or(target, source) \
+  blox_bits_combine_(&(target), &(source), BLOX_BITS_OR)
+
+#define blox_bits_xor(target, source) \
+  blox_bits_combine_(&(target), &(source), BLOX_BITS_XOR)
+
+#define blox_bits_andnot(target, source) \
+  blox_bits_combine_(&(target), &(source), BLOX_BITS_ANDNOT)
+
+size_t blox_bits_count_scalar_(const uint64_t* words, size_t count) {
+  size_t total = 0;
+  for (size_t index = 0; index < count; ++index)
+    total += blox_popcount_(words[index]);
+  return total;
+}
+
+#if defined(BLOX_SIMD_X86)
+
+/*
+ Returns non-zero if the POPCNT instruction is available
+*/
+int blox_cpu_popcnt_(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  static int supported = -1;
+  if (supported < 0) {
+    int info[4];
+    __cpuid(info, 1);
+    supported = (info[2] & (1 << 23)) != 0;
+  }
+  return supported;
+#else
+  static int supported = -1;
+  if (supported < 0) {
+    __builtin_cpu_init();
+    supported = __builtin_cpu_supports("popcnt") != 0;
+  }
+  return supported;
+#endif
+}
+
+/*
+ Four independent sums keep several POPCNTs in flight at once
+*/
+BLOX_TARGET("popcnt")
+size_t blox_bits_count_popcnt_(const uint64_t* words, size_t count) {
+  size_t sums[4] = {0, 0, 0, 0};
+  size_t index = 0;
+  for (; index + 4 <= count; index += 4) {
+    sums[0] += (size_t)_mm_popcnt_u64(words[index]);
+    sums[1] += (size_t)_mm_popcnt_u64(words[index + 1]);
+    sums[2] += (size_t)_mm_popcnt_u64(words[index + 2]);
+    sums[3] += (size_t)_mm_popcnt_u64(words[index + 3]);
+  }
+  for (; index < count; ++index)
+    sums[0] += (size_t)_mm_popcnt_u64(words[index]);
+  return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+#endif
+
+size_t blox_bits_count_words_(const uint64_t* words, size_t count) {
+#if defined(BLOX_SIMD_X86)
+  if (blox_cpu_popcnt_())
+    return blox_bits_count_popcnt_(words, count);
+#endif
+  return blox_bits_count_scalar_(words, count);
+}
+
+#define blox_bits_count(bits)                                  \
+  blox_bits_count_words_(blox_data(uint64_t, (bits).words), \
+                         (bits).words.length)
+
+/*
+ Index of the first set bit at or after `start`, or `length` if none
+*/
+size_t blox_bits_next_(const blox_bits* bits, size_t start) {
+  if (start >= bits->length)
+    return bits->length;
+  const uint64_t* words = blox_data(uint64_t, bits->words);
+  size_t index = start / 64;
+  uint64_t word = words[index] & (~(uint64_t)0 << (start % 64));
+  while (word == 0) {
+    if (++index == bits->words.length)
+      return bits->length;
+    word = words[index];
+  }
+  return index * 64 + blox_ctz_(word);
+}
+
+#define blox_bits_next(bits, start) blox_bits_next_(&(bits), start)
+
+#define blox_bits_first(bits) blox_bits_next(bits, 0)
+
+/*
+ Number of set bits before `index` (a linear pass over the words)
+*/
+size_t blox_bits_rank_(const blox_bits* bits, size_t index) {
+  if (index > bits->length)
+    index = bits->length;
+  const uint64_t* words = blox_data(uint64_t, bits->words);
+  size_t total = blox_bits_count_words_(words, index / 64);
+  if (index % 64 != 0)
+    total += blox_popcount_(words[index / 64] &
+                            (((uint64_t)1 << (index % 64)) - 1));
+  return total;
+}
+
+#define blox_bits_rank(bits, index) blox_bits_rank_(&(bits), index)
+
+/*
+ Index of the set bit with rank `rank` (counting from zero), or `length`
+ if there are not that many
+*/
+size_t blox_bits_select_(const blox_bits* bits, size_t rank) {
+  const uint64_t* words = blox_data(uint64_t, bits->words);
+  size_t count = bits->words.length;
+  size_t index = 0;
+  for (; index + 8 <= count; index += 8) {
+    size_t block = blox_bits_count_words_(words + index, 8);
+    if (rank < block)
+      break;
+    rank -= block;
+  }
+  for (; index < count; ++index) {
+    uint64_t word = words[index];
+    size_t ones = blox_popcount_(word);
+    if (rank < ones) {
+      while (rank--)
+        word &= word - 1;
+      return index * 64 + blox_ctz_(word);
+    }
+    rank -= ones;
+  }
+  return bits->length;
+}
+
+#define blox_bits_select(bits, rank) blox_bits_select_(&(bits), rank)
+
+#define blox_bits_free(bits) \
+  do {                       \
+    blox_free((bits).words); \
+    (bits).length = 0;       \
+  } while (0)
+
+#endif  // BLOX_BITS_H_INCLUDED
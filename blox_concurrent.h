@@ -0,0 +1,250 @@
+/* Blox Array Library - Concurrent Append
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_CONCURRENT_H_INCLUDED
+#define BLOX_CONCURRENT_H_INCLUDED
+
+#include "blox.h"
+
+/*
+ Number of elements in the first segment (a power of two); each further
+ segment is twice as large as the previous one
+*/
+#ifndef BLOX_CONCURRENT_FIRST
+#define BLOX_CONCURRENT_FIRST 1024
+#endif
+
+#define BLOX_CONCURRENT_SEGMENTS 48
+
+/*
+ Multi-producer append-only container. Slots are claimed with an atomic
+ fetch-add and live in geometrically growing segments which are never
+ moved, so any number of threads may append concurrently (and keep
+ pointers to their elements). Once the producers are done the elements
+ are frozen into an ordinary blox. The heap (bound at initialization) has
+ to be thread-safe, which the default one is.
+*/
+typedef struct {
+  void* segments[BLOX_CONCURRENT_SEGMENTS];
+  size_t width;
+  size_t reserved;
+  size_t committed;
+  blox_heap* heap;
+} blox_concurrent;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+size_t blox_atomic_add_(size_t* target, size_t amount) {
+  return (size_t)_InterlockedExchangeAdd64((volatile __int64*)target,
+                                           (__int64)amount);
+}
+
+size_t blox_atomic_load_(size_t* target) {
+  return (size_t)_InterlockedOr64((volatile __int64*)target, 0);
+}
+
+void* blox_atomic_pointer_(void** target) {
+  return _InterlockedCompareExchangePointer(target, NULL, NULL);
+}
+
+/* Returns the pointer that ends up in `target` */
+void* blox_atomic_publish_(void** target, void* pointer) {
+  void* previous = _InterlockedCompareExchangePointer(target, pointer, NULL);
+  return previous ? previous : pointer;
+}
+
+#else
+
+size_t blox_atomic_add_(size_t* target, size_t amount) {
+  return __atomic_fetch_add(target, amount, __ATOMIC_ACQ_REL);
+}
+
+size_t blox_atomic_load_(size_t* target) {
+  return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+void* blox_atomic_pointer_(void** target) {
+  return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+void* blox_atomic_publish_(void** target, void* pointer) {
+  void* expected = NULL;
+  if (__atomic_compare_exchange_n(target, &expected, pointer, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    return pointer;
+  return expected;
+}
+
+#endif
+
+void blox_concurrent_init_(blox_concurrent* list, size_t width) {
+  memset(list, 0, sizeof(*list));
+  list->width = width;
+  list->heap = blox_current_heap();
+}
+
+#define blox_concurrent_init(TYPE, list) \
+  blox_concurrent_init_(&(list), sizeof(TYPE))
+
+#define blox_concurrent__shift \
+  (63 - blox_clz_((uint64_t)BLOX_CONCURRENT_FIRST))
+
+size_t blox_concurrent_segment_(size_t index) {
+  return 63 - blox_clz_((uint64_t)index + BLOX_CONCURRENT_FIRST) -
+         blox_concurrent__shift;
+}
+
+#define blox_concurrent__start(segment) \
+  (((size_t)BLOX_CONCURRENT_FIRST << (segment)) - BLOX_CONCURRENT_FIRST)
+
+#define blox_concurrent__size(segment) \
+  ((size_t)BLOX_CONCURRENT_FIRST << (segment))
+
+/*
+ Returns the segment, allocating it if no other thread has yet (the loser
+ of a race releases its allocation); NULL if out of memory
+*/
+void* blox_concurrent_claim_(blox_concurrent* list, size_t segment) {
+  void** slot = list->segments + segment;
+  void* data = blox_atomic_pointer_(slot);
+  if (data != NULL)
+    return data;
+  blox_heap* heap = list->heap;
+  void* fresh = heap->allocate(heap->context,
+                               blox_concurrent__size(segment) * list->width,
+                               heap->alignment);
+  if (fresh == NULL)
+    return NULL;
+  data = blox_atomic_publish_(slot, fresh);
+  if (data != fresh)
+    heap->release(heap->context, fresh);
+  return data;
+}
+
+/*
+ Appends `count` elements from any thread; returns the index of the first
+ one, or (size_t)-1 if a segment couldn't be allocated (which leaves a gap
+ of unwritten slots behind)
+*/
+size_t blox_concurrent_append_(blox_concurrent* list,
+                               const void* data,
+                               size_t count) {
+  typedef unsigned char byte;
+  const byte* source = (const byte*)data;
+  size_t width = list->width;
+  size_t first = blox_atomic_add_(&list->reserved, count);
+  size_t index = first;
+  size_t left = count;
+  while (left) {
+    size_t segment = blox_concurrent_segment_(index);
+    size_t offset = index - blox_concurrent__start(segment);
+    size_t room = blox_concurrent__size(segment) - offset;
+    size_t amount = left < room ? left : room;
+    byte* target = (byte*)blox_concurrent_claim_(list, segment);
+    if (target == NULL)
+      return (size_t)-1;
+    memcpy(target + offset * width, source, amount * width);
+    source += amount * width;
+    index += amount;
+    left -= amount;
+  }
+  blox_atomic_add_(&list->committed, count);
+  return first;
+}
+
+#define blox_concurrent_push(TYPE, list, value) \
+  do {                                          \
+    TYPE item = (value);                        \
+    blox_concurrent_append_(&(list), &item, 1); \
+  } while (0)
+
+#define blox_concurrent_append(list, other) \
+  blox_concurrent_append_(&(list), (other).data, (other).length)
+
+/*
+ Number of elements whose writes have completed (while producers are
+ running these needn't be the first ones)
+*/
+#define blox_concurrent_length(list) blox_atomic_load_(&(list).committed)
+
+/*
+ Pointer to the element at `index` (which must have been written)
+*/
+#define blox_concurrent_index(TYPE, list, index)             \
+  ((TYPE*)(list).segments[blox_concurrent_segment_(index)] + \
+   ((index) - blox_concurrent__start(blox_concurrent_segment_(index))))
+
+void blox_concurrent_free_(blox_concurrent* list) {
+  blox_heap* heap = list->heap;
+  for (size_t segment = 0; segment < BLOX_CONCURRENT_SEGMENTS; ++segment)
+    if (list->segments[segment] != NULL)
+      heap->release(heap->context, list->segments[segment]);
+  memset(list->segments, 0, sizeof(list->segments));
+  list->reserved = 0;
+  list->committed = 0;
+}
+
+#define blox_concurrent_free(list) blox_concurrent_free_(&(list))
+
+/*
+ Moves the elements into one contiguous blox and empties the container;
+ must only be called once all producers have finished. When everything
+ fits in the first segment it is handed over as is, without copying.
+*/
+blox blox_concurrent_freeze_(blox_concurrent* list) {
+  typedef unsigned char byte;
+  size_t width = list->width;
+  size_t length = list->committed;
+  blox frozen = {0};
+  frozen.heap = list->heap;
+  if (length == 0) {
+    blox_concurrent_free_(list);
+    return blox_nil();
+  }
+  if (length < BLOX_CONCURRENT_FIRST) {
+    frozen.data = list->segments[0];
+    frozen.capacity = BLOX_CONCURRENT_FIRST;
+    list->segments[0] = NULL;
+  } else if (blox_reserve_(&frozen, width, length)) {
+    for (size_t index = 0; index < length;) {
+      size_t segment = blox_concurrent_segment_(index);
+      size_t amount = blox_concurrent__size(segment);
+      if (amount > length - index)
+        amount = length - index;
+      memcpy((byte*)frozen.data + index * width, list->segments[segment],
+             amount * width);
+      index += amount;
+    }
+  } else
+    return blox_nil();
+  frozen.length = length;
+  memset((byte*)frozen.data + length * width, 0, width);
+  blox_concurrent_free_(list);
+  return frozen;
+}
+
+#define blox_concurrent_freeze(list) blox_concurrent_freeze_(&(list))
+
+#endif  // BLOX_CONCURRENT_H_INCLUDED
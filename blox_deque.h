@@ -0,0 +1,169 @@
+/* Blox Array Library - Deque
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_DEQUE_H_INCLUDED
+#define BLOX_DEQUE_H_INCLUDED
+
+#include "blox.h"
+
+/*
+ Double-ended queue on top of blox storage: elements live in `ring`
+ starting at `head` and wrap around at `ring.capacity`, so pushing and
+ popping at either end never moves existing elements
+*/
+typedef struct {
+  blox ring;
+  size_t head;
+} blox_deque;
+
+#define blox_deque_length(deque) (deque).ring.length
+
+#define blox_deque_empty(deque) (blox_deque_length(deque) == 0)
+
+#define blox_deque_capacity(deque) (deque).ring.capacity
+
+#define blox_deque__wrap(deque, index)                      \
+  ((deque).head + (index) < (deque).ring.capacity           \
+       ? (deque).head + (index)                             \
+       : (deque).head + (index) - (deque).ring.capacity)
+
+#define blox_deque_index(TYPE, deque, index) \
+  blox_index(TYPE, (deque).ring, blox_deque__wrap(deque, index))
+
+#define blox_deque_get(TYPE, deque, index) \
+  (*blox_deque_index(TYPE, deque, index))
+
+#define blox_deque_set(TYPE, deque, index, value) \
+  (blox_deque_get(TYPE, deque, index) = (TYPE)(value))
+
+#define blox_deque_front(TYPE, deque) blox_deque_get(TYPE, deque, 0)
+
+#define blox_deque_back(TYPE, deque) \
+  blox_deque_get(TYPE, deque, blox__safe_last((deque).ring))
+
+/*
+ Grows the ring if it is full, unwrapping the elements that sit between
+ `head` and the end of the old storage
+*/
+int blox_deque_reserve_(blox_deque* deque, size_t width, size_t request) {
+  blox* ring = &deque->ring;
+  size_t capacity = ring->capacity;
+  if (request < capacity)
+    return 1;
+  if (!blox_ensure_(ring, width, request))
+    return 0;
+  if (deque->head + ring->length > capacity) {
+    typedef unsigned char byte;
+    size_t trailing = capacity - deque->head;
+    size_t head = ring->capacity - trailing;
+    memmove((byte*)ring->data + head * width,
+            (byte*)ring->data + deque->head * width, trailing * width);
+    deque->head = head;
+  }
+  return 1;
+}
+
+#define blox_deque_reserve(TYPE, deque, size) \
+  blox_deque_reserve_(&(deque), sizeof(TYPE), size)
+
+#define blox_deque_push(TYPE, deque, value)                       \
+  do {                                                            \
+    size_t length = (deque).ring.length;                          \
+    if (!blox_deque_reserve_(&(deque), sizeof(TYPE), length + 1)) \
+      break;                                                      \
+    *blox_deque_index(TYPE, deque, length) = (value);             \
+    ++(deque).ring.length;                                        \
+  } while (0)
+
+#define blox_deque_unshift(TYPE, deque, value)                    \
+  do {                                                            \
+    size_t length = (deque).ring.length;                          \
+    if (!blox_deque_reserve_(&(deque), sizeof(TYPE), length + 1)) \
+      break;                                                      \
+    if ((deque).head == 0)                                        \
+      (deque).head = (deque).ring.capacity;                       \
+    --(deque).head;                                               \
+    blox_get(TYPE, (deque).ring, (deque).head) = (value);         \
+    ++(deque).ring.length;                                        \
+  } while (0)
+
+#define blox_deque_pop_by(TYPE, deque, amount)                \
+  do {                                                        \
+    size_t count = (amount);                                  \
+    size_t length = (deque).ring.length;                      \
+    (deque).ring.length = blox__safe_subtract(length, count); \
+  } while (0)
+
+#define blox_deque_pop(TYPE, deque) blox_deque_pop_by(TYPE, deque, 1)
+
+#define blox_deque_shift_by(TYPE, deque, amount)   \
+  do {                                             \
+    size_t count = (amount);                       \
+    if (count > (deque).ring.length)               \
+      count = (deque).ring.length;                 \
+    (deque).head = blox_deque__wrap(deque, count); \
+    (deque).ring.length -= count;                  \
+    if ((deque).ring.length == 0)                  \
+      (deque).head = 0;                            \
+  } while (0)
+
+#define blox_deque_shift(TYPE, deque) blox_deque_shift_by(TYPE, deque, 1)
+
+/*
+ Rearranges the storage so that the elements are contiguous, then
+ returns a view of them (O(1) unless the elements currently wrap around)
+*/
+blox blox_deque_linearize_(blox_deque* deque, size_t width) {
+  typedef unsigned char byte;
+  blox* ring = &deque->ring;
+  size_t length = ring->length;
+  if (deque->head + length > ring->capacity) {
+    blox fresh = {0};
+    fresh.heap = ring->heap;
+    if (!blox_reallocate_(&fresh, width, ring->capacity))
+      return blox_nil();
+    size_t trailing = ring->capacity - deque->head;
+    memcpy(fresh.data, (byte*)ring->data + deque->head * width,
+           trailing * width);
+    memcpy((byte*)fresh.data + trailing * width, ring->data,
+           (length - trailing) * width);
+    fresh.length = length;
+    blox_release_(ring);
+    *ring = fresh;
+    deque->head = 0;
+  }
+  return blox_use((byte*)ring->data + deque->head * width, length);
+}
+
+#define blox_deque_view(TYPE, deque) \
+  blox_deque_linearize_(&(deque), sizeof(TYPE))
+
+#define blox_deque_free(deque) \
+  do {                         \
+    blox_free((deque).ring);   \
+    (deque).head = 0;          \
+  } while (0)
+
+#endif  // BLOX_DEQUE_H_INCLUDED
@@ -0,0 +1,329 @@
+/* Blox Array Library - Gap Buffers
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_GAP_H_INCLUDED
+#define BLOX_GAP_H_INCLUDED
+
+#include <stddef.h>
+#include "blox.h"
+
+/*
+ One splice of a batch: `erase` elements are removed at `position` and
+ the elements of `insert` put in their place. Positions refer to the
+ container before any of the edits are made.
+*/
+typedef struct {
+  size_t position;
+  size_t erase;
+  blox insert;
+} blox_edit;
+
+/*
+ Applies `count` edits, sorted by position and not overlapping, in a
+ single pass: each unchanged run of elements is moved at most once (runs
+ shifting left front to back, then runs shifting right back to front)
+ before the inserted elements are copied in. Returns 0 without changing
+ anything if the edits are invalid or memory ran out.
+*/
+int blox_splice_batch_(blox* buffer,
+                       size_t width,
+                       const blox_edit* edits,
+                       size_t count) {
+  typedef unsigned char byte;
+  size_t length = buffer->length;
+  size_t total = length;
+  size_t previous = 0;
+  for (size_t index = 0; index < count; ++index) {
+    const blox_edit* edit = &edits[index];
+    if (edit->position < previous || edit->position > length ||
+        edit->erase > length - edit->position)
+      return 0;
+    previous = edit->position + edit->erase;
+    total = total - edit->erase + edit->insert.length;
+  }
+  if (!blox_ensure_(buffer, width, total))
+    return 0;
+  byte* data = (byte*)buffer->data;
+  ptrdiff_t shift = 0;
+  for (size_t run = 0; run <= count; ++run) {
+    size_t start = run ? edits[run - 1].position + edits[run - 1].erase : 0;
+    size_t end = run < count ? edits[run].position : length;
+    if (shift < 0 && end > start) {
+      BLOX__STAT(MOVED, (end - start) * width);
+      memmove(data + (start + shift) * width, data + start * width,
+              (end - start) * width);
+    }
+    if (run < count)
+      shift += (ptrdiff_t)edits[run].insert.length -
+               (ptrdiff_t)edits[run].erase;
+  }
+  for (size_t run = count + 1; run-- > 0;) {
+    size_t start = run ? edits[run - 1].position + edits[run - 1].erase : 0;
+    size_t end = run < count ? edits[run].position : length;
+    if (run < count)
+      shift -= (ptrdiff_t)edits[run].insert.length -
+               (ptrdiff_t)edits[run].erase;
+    if (shift > 0 && end > start) {
+      BLOX__STAT(MOVED, (end - start) * width);
+      memmove(data + (start + shift) * width, data + start * width,
+              (end - start) * width);
+    }
+  }
+  for (size_t index = 0; index < count; ++index) {
+    const blox_edit* edit = &edits[index];
+    size_t amount = edit->insert.length;
+    if (amount != 0) {
+      BLOX__STAT(MOVED, amount * width);
+      memcpy(data + (edit->position + shift) * width, edit->insert.data,
+             amount * width);
+    }
+    shift += (ptrdiff_t)amount - (ptrdiff_t)edit->erase;
+  }
+  memset(data + total * width, 0, width);
+  buffer->length = total;
+  return 1;
+}
+
+#define blox_splice_batch(TYPE, buffer, edits, count) \
+  BLOX__SITED(blox_splice_batch_(&(buffer), sizeof(TYPE), edits, count))
+
+/*
+ Gap buffer: the elements before the cursor sit at the start of
+ `storage`, the `after` elements following it at the very end, and the
+ free space in between is the gap. Moving the cursor only moves the
+ elements it passes over, so edits close to one another cost no more
+ than their size. `storage.length` is the number of elements.
+*/
+typedef struct {
+  blox storage;
+  size_t gap;
+  size_t after;
+} blox_gap;
+
+#define blox_gap_length(buffer) (buffer).storage.length
+
+#define blox_gap_empty(buffer) (blox_gap_length(buffer) == 0)
+
+#define blox_gap_cursor(buffer) (buffer).gap
+
+#define blox_gap__slot(buffer, index) \
+  ((index) < (buffer).gap             \
+       ? (index)                      \
+       : (index) + (buffer).storage.capacity - (buffer).storage.length)
+
+#define blox_gap_index(TYPE, buffer, index) \
+  blox_index(TYPE, (buffer).storage, blox_gap__slot(buffer, index))
+
+#define blox_gap_get(TYPE, buffer, index) \
+  (*blox_gap_index(TYPE, buffer, index))
+
+#define blox_gap_set(TYPE, buffer, index, value) \
+  (blox_gap_get(TYPE, buffer, index) = (TYPE)(value))
+
+/*
+ Moves the gap so that it starts at `position` (clamped to the length)
+*/
+void blox_gap_seek_(blox_gap* buffer, size_t width, size_t position) {
+  typedef unsigned char byte;
+  byte* data = (byte*)buffer->storage.data;
+  size_t back = buffer->storage.capacity - buffer->after;
+  if (position > buffer->storage.length)
+    position = buffer->storage.length;
+  if (position < buffer->gap) {
+    size_t amount = buffer->gap - position;
+    memmove(data + (back - amount) * width, data + position * width,
+            amount * width);
+    BLOX__STAT(MOVED, amount * width);
+    buffer->after += amount;
+  } else if (position > buffer->gap) {
+    size_t amount = position - buffer->gap;
+    memmove(data + buffer->gap * width, data + back * width, amount * width);
+    BLOX__STAT(MOVED, amount * width);
+    buffer->after -= amount;
+  }
+  buffer->gap = position;
+}
+
+#define blox_gap_seek(TYPE, buffer, position) \
+  blox_gap_seek_(&(buffer), sizeof(TYPE), position)
+
+/*
+ Widens the gap to at least `amount` elements (plus one, so that the
+ storage can always be turned back into a terminated blox), following
+ the growth policy of the storage's heap
+*/
+int blox_gap_reserve_(blox_gap* buffer, size_t width, size_t amount) {
+  typedef unsigned char byte;
+  blox* storage = &buffer->storage;
+  size_t capacity = storage->capacity;
+  if (storage->length + amount < capacity)
+    return 1;
+  if (!blox_ensure_(storage, width, storage->length + amount))
+    return 0;
+  byte* data = (byte*)storage->data;
+  memmove(data + (storage->capacity - buffer->after) * width,
+          data + (capacity - buffer->after) * width, buffer->after * width);
+  BLOX__STAT(MOVED, buffer->after * width);
+  return 1;
+}
+
+#define blox_gap_reserve(TYPE, buffer, amount) \
+  blox_gap_reserve_(&(buffer), sizeof(TYPE), amount)
+
+/*
+ Inserts `count` elements at `position`, leaving the cursor after them
+*/
+int blox_gap_splice_(blox_gap* buffer,
+                     size_t width,
+                     size_t position,
+                     const void* source,
+                     size_t count) {
+  if (!blox_gap_reserve_(buffer, width, count))
+    return 0;
+  blox_gap_seek_(buffer, width, position);
+  if (count != 0) {
+    memcpy((unsigned char*)buffer->storage.data + buffer->gap * width, source,
+           count * width);
+    BLOX__STAT(MOVED, count * width);
+  }
+  buffer->gap += count;
+  buffer->storage.length += count;
+  return 1;
+}
+
+#define blox_gap_splice(TYPE, buffer, position, other)            \
+  BLOX__SITED(blox_gap_splice_(&(buffer), sizeof(TYPE), position, \
+                               (other).data, (other).length))
+
+#define blox_gap_splice_array(TYPE, buffer, position, array, length)     \
+  BLOX__SITED(blox_gap_splice_(&(buffer), sizeof(TYPE), position, array, \
+                               length))
+
+#define blox_gap_insert(TYPE, buffer, position, value)                        \
+  blox_gap_splice_array(TYPE, buffer, position, BLOX__TEMPORARY(TYPE, value), \
+                        1)
+
+#define blox_gap_push(TYPE, buffer, value) \
+  blox_gap_insert(TYPE, buffer, (buffer).storage.length, value)
+
+/*
+ Removes `amount` elements starting at `position`, leaving the cursor there
+*/
+void blox_gap_erase_(blox_gap* buffer,
+                     size_t width,
+                     size_t position,
+                     size_t amount) {
+  size_t length = buffer->storage.length;
+  if (position >= length)
+    return;
+  if (amount > length - position)
+    amount = length - position;
+  blox_gap_seek_(buffer, width, position);
+  buffer->after -= amount;
+  buffer->storage.length -= amount;
+}
+
+#define blox_gap_erase_at(TYPE, buffer, position, amount) \
+  blox_gap_erase_(&(buffer), sizeof(TYPE), position, amount)
+
+#define blox_gap_erase(TYPE, buffer, position) \
+  blox_gap_erase_at(TYPE, buffer, position, 1)
+
+/*
+ Closes the gap by moving it to the end, after which `storage` is an
+ ordinary zero-terminated blox
+*/
+void blox_gap_compact_(blox_gap* buffer, size_t width) {
+  blox_gap_seek_(buffer, width, buffer->storage.length);
+  if (buffer->storage.data != NULL)
+    memset((unsigned char*)buffer->storage.data +
+               buffer->storage.length * width,
+           0, width);
+}
+
+/*
+ View of the elements (invalidated by the next edit)
+*/
+#define blox_gap_view(TYPE, buffer)            \
+  (blox_gap_compact_(&(buffer), sizeof(TYPE)), \
+   blox_use((buffer).storage.data, (buffer).storage.length))
+
+/*
+ Takes over an ordinary blox (without copying, unless it is a view), with
+ the cursor at the end
+*/
+blox_gap blox_gap_from_(blox* source, size_t width) {
+  blox_gap buffer = {{0}, 0, 0};
+  buffer.storage = *source;
+  if (source->heap == blox_borrowed_heap())
+    buffer.storage = blox_clone_(width, source->data, source->length);
+  buffer.gap = buffer.storage.length;
+  blox_drop(*source);
+  return buffer;
+}
+
+#define blox_gap_from(TYPE, buffer) \
+  BLOX__SITED(blox_gap_from_(&(buffer), sizeof(TYPE)))
+
+/*
+ Hands the elements over as an ordinary blox (without copying), leaving
+ the gap buffer empty
+*/
+blox blox_gap_detach_(blox_gap* buffer, size_t width) {
+  blox_gap_compact_(buffer, width);
+  blox result = buffer->storage;
+  blox_drop(buffer->storage);
+  buffer->gap = 0;
+  buffer->after = 0;
+  return result;
+}
+
+#define blox_gap_detach(TYPE, buffer) blox_gap_detach_(&(buffer), sizeof(TYPE))
+
+/*
+ Applies a batch of edits (see `blox_splice_batch`) in one pass, with the
+ cursor ending up at the end
+*/
+int blox_gap_apply_(blox_gap* buffer,
+                    size_t width,
+                    const blox_edit* edits,
+                    size_t count) {
+  blox_gap_compact_(buffer, width);
+  int result = blox_splice_batch_(&buffer->storage, width, edits, count);
+  buffer->gap = buffer->storage.length;
+  return result;
+}
+
+#define blox_gap_apply(TYPE, buffer, edits, count) \
+  BLOX__SITED(blox_gap_apply_(&(buffer), sizeof(TYPE), edits, count))
+
+#define blox_gap_free(buffer)    \
+  do {                           \
+    blox_free((buffer).storage); \
+    (buffer).gap = 0;            \
+    (buffer).after = 0;          \
+  } while (0)
+
+#endif  // BLOX_GAP_H_INCLUDED
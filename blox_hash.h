@@ -0,0 +1,296 @@
+/* Blox Array Library - Hash Tables
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_HASH_H_INCLUDED
+#define BLOX_HASH_H_INCLUDED
+
+#include "blox.h"
+
+#ifndef BLOX_HASH_MIGRATE
+#define BLOX_HASH_MIGRATE 16
+#endif
+
+/*
+ Open-addressing (linear probing) hash table. Slots live in a flat blox
+ allocated from the heap of `table` (or the current heap). Growing doesn't
+ rehash everything at once: the previous table is kept in `old` and a few
+ of its slots are moved over on every insert or erase.
+*/
+typedef struct {
+  blox table;
+  blox old;
+  size_t count;
+  size_t old_count;
+  size_t cursor;
+} blox_hash;
+
+#define blox_hash_length(hash) ((hash).count + (hash).old_count)
+
+#define blox_hash_empty(hash) (blox_hash_length(hash) == 0)
+
+#define blox_hash_free(hash)  \
+  do {                        \
+    blox_free((hash).table);  \
+    blox_free((hash).old);    \
+    (hash).count = 0;         \
+    (hash).old_count = 0;     \
+    (hash).cursor = 0;        \
+  } while (0)
+
+uint64_t blox_hash_integer_(uint64_t value) {
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+uint64_t blox_hash_bytes_(const void* data, size_t size) {
+  return blox_content_hash_(data, size, 0);
+}
+
+/*
+ Default HASH and EQUAL for BLOX_DEFINE_HASH_MAP/SET; both receive
+ pointers to keys
+*/
+#define blox_hash_scalar(key) blox_hash_integer_((uint64_t)*(key))
+
+#define blox_equal_to(lhs, rhs) (*(lhs) == *(rhs))
+
+#define blox_hash_blox(TYPE, key) \
+  blox_hash_bytes_((key)->data, (key)->length * sizeof(TYPE))
+
+/*
+ Defines `uint64_t NAME(const blox*)` and `int NAME_equal(const blox*,
+ const blox*)`, a HASH and EQUAL pair for tables keyed by blox of `TYPE`
+ elements (by contents)
+*/
+#define BLOX_DEFINE_BLOX_HASH(NAME, TYPE)              \
+  uint64_t NAME(const blox* key) {                     \
+    return blox_hash_blox(TYPE, key);                  \
+  }                                                    \
+                                                       \
+  int NAME##_equal(const blox* lhs, const blox* rhs) { \
+    return blox_equal(TYPE, *lhs, *rhs);               \
+  }
+
+/*
+ HASH and EQUAL for tables keyed by `blox_key`, which reuse the hash
+ computed when the key was made
+*/
+#define blox_hash_key(key) ((key)->hash)
+
+#define blox_equal_key(lhs, rhs) blox_key_equal_(lhs, rhs)
+
+/*
+ Slot hashes of 0 and 1 mark empty and erased slots respectively
+*/
+#define blox__hash_code(value) \
+  ((size_t)(value) < 2 ? (size_t)(value) + 2 : (size_t)(value))
+
+#define BLOX__DEFINE_HASH_CORE(NAME, KEY, HASH, EQUAL)                        \
+  NAME##_entry* NAME##_probe_(blox* table, size_t code, const KEY* key) {     \
+    size_t mask = table->length - 1;                                          \
+    NAME##_entry* slots = (NAME##_entry*)table->data;                         \
+    if (table->length == 0)                                                   \
+      return NULL;                                                            \
+    for (size_t index = code & mask;; index = (index + 1) & mask) {           \
+      NAME##_entry* slot = slots + index;                                     \
+      if (slot->hash == 0)                                                    \
+        return NULL;                                                          \
+      if (slot->hash == code && EQUAL(&slot->key, key))                       \
+        return slot;                                                          \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  NAME##_entry* NAME##_vacancy_(blox* table, size_t code) {                   \
+    size_t mask = table->length - 1;                                          \
+    NAME##_entry* slots = (NAME##_entry*)table->data;                         \
+    size_t index = code & mask;                                               \
+    while (slots[index].hash != 0)                                            \
+      index = (index + 1) & mask;                                             \
+    return slots + index;                                                     \
+  }                                                                           \
+                                                                              \
+  void NAME##_migrate_(blox_hash* hash, size_t budget) {                      \
+    NAME##_entry* slots = (NAME##_entry*)hash->old.data;                      \
+    while (hash->old_count && budget-- && hash->cursor < hash->old.length) {  \
+      NAME##_entry* slot = slots + hash->cursor++;                            \
+      if (slot->hash < 2)                                                     \
+        continue;                                                             \
+      *NAME##_vacancy_(&hash->table, slot->hash) = *slot;                     \
+      slot->hash = 1;                                                         \
+      ++hash->count;                                                          \
+      --hash->old_count;                                                      \
+    }                                                                         \
+    if (hash->old_count == 0 && hash->old.data != NULL) {                     \
+      blox_free(hash->old);                                                   \
+      hash->cursor = 0;                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  int NAME##_rehash_(blox_hash* hash, size_t slots) {                         \
+    NAME##_migrate_(hash, (size_t)-1);                                        \
+    blox fresh = {0};                                                         \
+    fresh.heap = hash->table.heap;                                            \
+    if (!blox_reserve_(&fresh, sizeof(NAME##_entry), slots))                  \
+      return 0;                                                               \
+    memset(fresh.data, 0, slots * sizeof(NAME##_entry));                      \
+    fresh.length = slots;                                                     \
+    hash->old = hash->table;                                                  \
+    hash->old_count = hash->count;                                            \
+    hash->cursor = 0;                                                         \
+    hash->table = fresh;                                                      \
+    hash->count = 0;                                                          \
+    if (hash->old_count == 0)                                                 \
+      blox_free(hash->old);                                                   \
+    return 1;                                                                 \
+  }                                                                           \
+                                                                              \
+  size_t NAME##_slots_(size_t count, size_t slots) {                          \
+    if (slots < 16)                                                           \
+      slots = 16;                                                             \
+    while (count * 4 > slots * 3)                                             \
+      slots *= 2;                                                             \
+    return slots;                                                             \
+  }                                                                           \
+                                                                              \
+  NAME##_entry* NAME##_lookup_(blox_hash* hash, const KEY* key) {             \
+    size_t code = blox__hash_code(HASH(key));                                 \
+    NAME##_entry* slot = NULL;                                                \
+    if (hash->old_count)                                                      \
+      slot = NAME##_probe_(&hash->old, code, key);                            \
+    return slot ? slot : NAME##_probe_(&hash->table, code, key);              \
+  }                                                                           \
+                                                                              \
+  NAME##_entry* NAME##_claim_(blox_hash* hash, const KEY* key, int* created) {\
+    NAME##_migrate_(hash, BLOX_HASH_MIGRATE);                                 \
+    NAME##_entry* slot = NAME##_lookup_(hash, key);                           \
+    *created = 0;                                                             \
+    if (slot)                                                                 \
+      return slot;                                                            \
+    size_t total = blox_hash_length(*hash) + 1;                               \
+    if (total * 4 > hash->table.length * 3 &&                                 \
+        !NAME##_rehash_(hash, NAME##_slots_(total, hash->table.length * 2)))  \
+      return NULL;                                                            \
+    size_t code = blox__hash_code(HASH(key));                                 \
+    slot = NAME##_vacancy_(&hash->table, code);                               \
+    slot->hash = code;                                                        \
+    slot->key = *key;                                                         \
+    ++hash->count;                                                            \
+    *created = 1;                                                             \
+    return slot;                                                              \
+  }                                                                           \
+                                                                              \
+  /* Erased slots of the old table are marked; in the current table the */   \
+  /* following entries are shifted back instead (no tombstones) */            \
+  int NAME##_erase(blox_hash* hash, KEY key) {                                \
+    NAME##_migrate_(hash, BLOX_HASH_MIGRATE);                                 \
+    size_t code = blox__hash_code(HASH(&key));                                \
+    NAME##_entry* slot = NULL;                                                \
+    if (hash->old_count && (slot = NAME##_probe_(&hash->old, code, &key))) {  \
+      slot->hash = 1;                                                         \
+      --hash->old_count;                                                      \
+      NAME##_migrate_(hash, 0);                                               \
+      return 1;                                                               \
+    }                                                                         \
+    if ((slot = NAME##_probe_(&hash->table, code, &key)) == NULL)             \
+      return 0;                                                               \
+    NAME##_entry* slots = (NAME##_entry*)hash->table.data;                    \
+    size_t mask = hash->table.length - 1;                                     \
+    size_t hole = (size_t)(slot - slots);                                     \
+    for (size_t next = (hole + 1) & mask; slots[next].hash != 0;              \
+         next = (next + 1) & mask) {                                          \
+      size_t home = slots[next].hash & mask;                                  \
+      if (((next - home) & mask) >= ((next - hole) & mask)) {                 \
+        slots[hole] = slots[next];                                            \
+        hole = next;                                                          \
+      }                                                                       \
+    }                                                                         \
+    slots[hole].hash = 0;                                                     \
+    --hash->count;                                                            \
+    return 1;                                                                 \
+  }                                                                           \
+                                                                              \
+  /* Makes room for `count` entries up front (rehashing immediately) */      \
+  int NAME##_reserve(blox_hash* hash, size_t count) {                         \
+    size_t slots = NAME##_slots_(count, hash->table.length);                  \
+    if (slots > hash->table.length && !NAME##_rehash_(hash, slots))           \
+      return 0;                                                               \
+    NAME##_migrate_(hash, (size_t)-1);                                        \
+    return 1;                                                                 \
+  }
+
+/*
+ Stamps out a hash map from KEY to VALUE:
+ `VALUE* NAME_insert(blox_hash*, KEY, VALUE)` (inserts or overwrites),
+ `VALUE* NAME_find(blox_hash*, KEY)`, `int NAME_erase(blox_hash*, KEY)` and
+ `int NAME_reserve(blox_hash*, size_t)`
+*/
+#define BLOX_DEFINE_HASH_MAP(NAME, KEY, VALUE, HASH, EQUAL)               \
+  typedef struct {                                                        \
+    size_t hash;                                                          \
+    KEY key;                                                              \
+    VALUE value;                                                          \
+  } NAME##_entry;                                                         \
+                                                                          \
+  BLOX__DEFINE_HASH_CORE(NAME, KEY, HASH, EQUAL)                          \
+                                                                          \
+  VALUE* NAME##_insert(blox_hash* hash, KEY key, VALUE value) {           \
+    int created;                                                          \
+    NAME##_entry* slot = NAME##_claim_(hash, &key, &created);             \
+    if (slot == NULL)                                                     \
+      return NULL;                                                        \
+    slot->value = value;                                                  \
+    return &slot->value;                                                  \
+  }                                                                       \
+                                                                          \
+  VALUE* NAME##_find(blox_hash* hash, KEY key) {                          \
+    NAME##_entry* slot = NAME##_lookup_(hash, &key);                      \
+    return slot ? &slot->value : NULL;                                    \
+  }
+
+/*
+ Stamps out a hash set of KEY: `int NAME_insert(blox_hash*, KEY)` (returns
+ 1 if the key wasn't present yet), `int NAME_contains(blox_hash*, KEY)`,
+ `int NAME_erase(blox_hash*, KEY)` and `int NAME_reserve(blox_hash*, size_t)`
+*/
+#define BLOX_DEFINE_HASH_SET(NAME, KEY, HASH, EQUAL)                      \
+  typedef struct {                                                        \
+    size_t hash;                                                          \
+    KEY key;                                                              \
+  } NAME##_entry;                                                         \
+                                                                          \
+  BLOX__DEFINE_HASH_CORE(NAME, KEY, HASH, EQUAL)                          \
+                                                                          \
+  int NAME##_insert(blox_hash* hash, KEY key) {                           \
+    int created;                                                          \
+    return NAME##_claim_(hash, &key, &created) != NULL && created;        \
+  }                                                                       \
+                                                                          \
+  int NAME##_contains(blox_hash* hash, KEY key) {                         \
+    return NAME##_lookup_(hash, &key) != NULL;                            \
+  }
+
+#endif  // BLOX_HASH_H_INCLUDED
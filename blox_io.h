@@ -0,0 +1,463 @@
+/* Blox Array Library - Serialization
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_IO_H_INCLUDED
+#define BLOX_IO_H_INCLUDED
+
+#include <errno.h>
+#include <unistd.h>
+#include "blox.h"
+
+#ifndef BLOX_IO_ALIGNMENT
+#define BLOX_IO_ALIGNMENT 64
+#endif
+
+#ifndef BLOX_IO_CHUNK
+#define BLOX_IO_CHUNK (1 << 20)
+#endif
+
+#define BLOX_IO_VERSION 1
+
+#define BLOX_IO_BYTE_ORDER 0x01020304u
+
+enum { BLOX_IO_FLAT, BLOX_IO_NESTED };
+
+enum {
+  BLOX_IO_OK,
+  BLOX_IO_FAILED,
+  BLOX_IO_NOT_BLOX,
+  BLOX_IO_UNSUPPORTED,
+  BLOX_IO_WRONG_ORDER,
+  BLOX_IO_WRONG_WIDTH,
+  BLOX_IO_MISALIGNED,
+  BLOX_IO_TRUNCATED,
+  BLOX_IO_CORRUPTED
+};
+
+/*
+ File layout: this header (in the writer's byte order, which `byte_order`
+ records), then for nested arrays `length + 1` uint64_t element offsets,
+ then padding up to a multiple of `alignment`, then the elements. The
+ checksum covers the offsets and the elements.
+*/
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t layout;
+  uint32_t byte_order;
+  uint32_t width;
+  uint32_t alignment;
+  uint32_t reserved;
+  uint64_t length;
+  uint64_t checksum;
+} blox_io_header;
+
+typedef struct {
+  uint64_t hash;
+  uint64_t word;
+  uint64_t count;
+} blox_io_checksum;
+
+#define blox_io__round(value, alignment) \
+  (((value) + ((alignment)-1)) / (alignment) * (alignment))
+
+uint64_t blox_io_mix_(uint64_t hash, uint64_t word) {
+  word *= 0x87C37B91114253D5ULL;
+  word = (word << 31) | (word >> 33);
+  hash ^= word * 0x4CF5AD432745937FULL;
+  return ((hash << 27) | (hash >> 37)) * 5 + 0x52DCE729;
+}
+
+void blox_io_checksum_init_(blox_io_checksum* sum) {
+  sum->hash = 0x9E3779B97F4A7C15ULL;
+  sum->word = 0;
+  sum->count = 0;
+}
+
+/*
+ Consumes bytes in 64-bit words, so chunk boundaries don't matter
+*/
+void blox_io_checksum_update_(blox_io_checksum* sum,
+                              const void* data,
+                              size_t size) {
+  const unsigned char* bytes = (const unsigned char*)data;
+  while (size && (sum->count & 7)) {
+    sum->word |= (uint64_t)*bytes++ << ((sum->count++ & 7) * 8);
+    if ((sum->count & 7) == 0) {
+      sum->hash = blox_io_mix_(sum->hash, sum->word);
+      sum->word = 0;
+    }
+    --size;
+  }
+  for (; size >= 8; size -= 8, bytes += 8, sum->count += 8) {
+    uint64_t word = 0;
+    for (int index = 0; index < 8; ++index)
+      word |= (uint64_t)bytes[index] << (index * 8);
+    sum->hash = blox_io_mix_(sum->hash, word);
+  }
+  while (size--)
+    sum->word |= (uint64_t)*bytes++ << ((sum->count++ & 7) * 8);
+}
+
+uint64_t blox_io_checksum_final_(blox_io_checksum* sum) {
+  uint64_t hash = blox_io_mix_(sum->hash, sum->word) ^ sum->count;
+  hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDULL;
+  return hash ^ (hash >> 33);
+}
+
+uint64_t blox_io_checksum_(const void* data, size_t size) {
+  blox_io_checksum sum;
+  blox_io_checksum_init_(&sum);
+  blox_io_checksum_update_(&sum, data, size);
+  return blox_io_checksum_final_(&sum);
+}
+
+int blox_io_write_all_(int fd, const void* data, size_t size) {
+  const char* bytes = (const char*)data;
+  while (size) {
+    ssize_t written = write(fd, bytes, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return 0;
+    bytes += written;
+    size -= (size_t)written;
+  }
+  return 1;
+}
+
+/*
+ Returns the number of bytes read, which is less than `size` only at the
+ end of the file or on error
+*/
+size_t blox_io_read_all_(int fd, void* data, size_t size) {
+  char* bytes = (char*)data;
+  size_t total = 0;
+  while (total < size) {
+    ssize_t got = read(fd, bytes + total, size - total);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      break;
+    total += (size_t)got;
+  }
+  return total;
+}
+
+blox_io_header blox_io_header_(int layout, size_t width, size_t length) {
+  blox_io_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "BLOX", 4);
+  header.version = BLOX_IO_VERSION;
+  header.layout = (uint16_t)layout;
+  header.byte_order = BLOX_IO_BYTE_ORDER;
+  header.width = (uint32_t)width;
+  header.alignment = BLOX_IO_ALIGNMENT;
+  header.length = length;
+  return header;
+}
+
+int blox_io_pad_(int fd, size_t size) {
+  static const char zeros[BLOX_IO_ALIGNMENT] = {0};
+  size_t padding = blox_io__round(size, BLOX_IO_ALIGNMENT) - size;
+  return blox_io_write_all_(fd, zeros, padding);
+}
+
+int blox_io_check_(const blox_io_header* header, int layout, size_t width) {
+  if (memcmp(header->magic, "BLOX", 4) != 0)
+    return BLOX_IO_NOT_BLOX;
+  if (header->byte_order != BLOX_IO_BYTE_ORDER)
+    return BLOX_IO_WRONG_ORDER;
+  if (header->version != BLOX_IO_VERSION || header->layout != layout ||
+      header->alignment == 0)
+    return BLOX_IO_UNSUPPORTED;
+  if (header->width != width)
+    return BLOX_IO_WRONG_WIDTH;
+  return BLOX_IO_OK;
+}
+
+/*
+ Writes `length` elements in one go
+*/
+int blox_io_write_(int fd, const void* data, size_t length, size_t width) {
+  blox_io_header header = blox_io_header_(BLOX_IO_FLAT, width, length);
+  header.checksum = blox_io_checksum_(data, length * width);
+  if (!blox_io_write_all_(fd, &header, sizeof(header)) ||
+      !blox_io_pad_(fd, sizeof(header)) ||
+      !blox_io_write_all_(fd, data, length * width))
+    return BLOX_IO_FAILED;
+  return BLOX_IO_OK;
+}
+
+#define blox_io_write(TYPE, fd, buffer) \
+  blox_io_write_(fd, (buffer).data, (buffer).length, sizeof(TYPE))
+
+/*
+ Writes a container of containers as element offsets plus one contiguous
+ run of elements
+*/
+int blox_io_write_nested_(int fd, blox outer, size_t width) {
+  blox_io_header header =
+      blox_io_header_(BLOX_IO_NESTED, width, outer.length);
+  blox_io_checksum sum;
+  blox* items = (blox*)outer.data;
+  uint64_t offset = 0;
+  blox_io_checksum_init_(&sum);
+  for (size_t index = 0; index <= outer.length; ++index) {
+    blox_io_checksum_update_(&sum, &offset, sizeof(offset));
+    if (index < outer.length)
+      offset += items[index].length;
+  }
+  for (size_t index = 0; index < outer.length; ++index)
+    blox_io_checksum_update_(&sum, items[index].data,
+                             items[index].length * width);
+  header.checksum = blox_io_checksum_final_(&sum);
+  if (!blox_io_write_all_(fd, &header, sizeof(header)))
+    return BLOX_IO_FAILED;
+  offset = 0;
+  for (size_t index = 0; index <= outer.length; ++index) {
+    if (!blox_io_write_all_(fd, &offset, sizeof(offset)))
+      return BLOX_IO_FAILED;
+    if (index < outer.length)
+      offset += items[index].length;
+  }
+  if (!blox_io_pad_(fd, sizeof(header) + (outer.length + 1) * sizeof(offset)))
+    return BLOX_IO_FAILED;
+  for (size_t index = 0; index < outer.length; ++index)
+    if (!blox_io_write_all_(fd, items[index].data, items[index].length * width))
+      return BLOX_IO_FAILED;
+  return BLOX_IO_OK;
+}
+
+#define blox_io_write_nested(TYPE, fd, outer) \
+  blox_io_write_nested_(fd, outer, sizeof(TYPE))
+
+/*
+ Streaming writer for data that arrives in pieces; the header is written
+ up front and patched by `blox_io_end`, so `fd` has to be seekable
+*/
+typedef struct {
+  int fd;
+  size_t width;
+  off_t start;
+  uint64_t length;
+  blox_io_checksum sum;
+} blox_io_writer;
+
+int blox_io_begin_(blox_io_writer* writer, int fd, size_t width) {
+  blox_io_header header = blox_io_header_(BLOX_IO_FLAT, width, 0);
+  writer->fd = fd;
+  writer->width = width;
+  writer->length = 0;
+  blox_io_checksum_init_(&writer->sum);
+  writer->start = lseek(fd, 0, SEEK_CUR);
+  if (writer->start < 0 || !blox_io_write_all_(fd, &header, sizeof(header)) ||
+      !blox_io_pad_(fd, sizeof(header)))
+    return BLOX_IO_FAILED;
+  return BLOX_IO_OK;
+}
+
+#define blox_io_begin(TYPE, writer, fd) blox_io_begin_(writer, fd, sizeof(TYPE))
+
+int blox_io_append_(blox_io_writer* writer, const void* data, size_t length) {
+  size_t size = length * writer->width;
+  blox_io_checksum_update_(&writer->sum, data, size);
+  writer->length += length;
+  return blox_io_write_all_(writer->fd, data, size) ? BLOX_IO_OK
+                                                    : BLOX_IO_FAILED;
+}
+
+#define blox_io_append(writer, buffer) \
+  blox_io_append_(writer, (buffer).data, (buffer).length)
+
+int blox_io_end(blox_io_writer* writer) {
+  blox_io_header header =
+      blox_io_header_(BLOX_IO_FLAT, writer->width, writer->length);
+  header.checksum = blox_io_checksum_final_(&writer->sum);
+  if (pwrite(writer->fd, &header, sizeof(header), writer->start) !=
+      (ssize_t)sizeof(header))
+    return BLOX_IO_FAILED;
+  return BLOX_IO_OK;
+}
+
+/*
+ Reads a flat array from `fd` (which may be a pipe) in chunks, appending
+ the elements to `buffer`
+*/
+int blox_io_read_(int fd, blox* buffer, size_t width) {
+  blox_io_header header;
+  char padding[BLOX_IO_ALIGNMENT];
+  if (blox_io_read_all_(fd, &header, sizeof(header)) != sizeof(header))
+    return BLOX_IO_TRUNCATED;
+  int status = blox_io_check_(&header, BLOX_IO_FLAT, width);
+  if (status != BLOX_IO_OK)
+    return status;
+  size_t skip = blox_io__round(sizeof(header), header.alignment) -
+                sizeof(header);
+  while (skip) {
+    size_t step = skip < sizeof(padding) ? skip : sizeof(padding);
+    if (blox_io_read_all_(fd, padding, step) != step)
+      return BLOX_IO_TRUNCATED;
+    skip -= step;
+  }
+  blox_io_checksum sum;
+  blox_io_checksum_init_(&sum);
+  uint64_t remaining = header.length;
+  size_t chunk = BLOX_IO_CHUNK / width ? BLOX_IO_CHUNK / width : 1;
+  while (remaining) {
+    size_t count = remaining < chunk ? (size_t)remaining : chunk;
+    if (!blox_ensure_(buffer, width, buffer->length + count))
+      return BLOX_IO_FAILED;
+    char* target = (char*)buffer->data + buffer->length * width;
+    size_t got = blox_io_read_all_(fd, target, count * width);
+    blox_io_checksum_update_(&sum, target, got);
+    buffer->length += got / width;
+    memset((char*)buffer->data + buffer->length * width, 0, width);
+    if (got != count * width)
+      return BLOX_IO_TRUNCATED;
+    remaining -= count;
+  }
+  if (blox_io_checksum_final_(&sum) != header.checksum)
+    return BLOX_IO_CORRUPTED;
+  return BLOX_IO_OK;
+}
+
+#define blox_io_read(TYPE, fd, buffer) \
+  blox_io_read_(fd, &(buffer), sizeof(TYPE))
+
+/*
+ Locates the elements of a serialized array inside `source` (for instance
+ a file mapped with `blox_map_view`, or one read into memory) without
+ copying them; `target` becomes a view into `source`
+*/
+int blox_io_load_(blox source,
+                  blox* target,
+                  size_t width,
+                  size_t natural,
+                  int verify) {
+  const char* bytes = (const char*)source.data;
+  blox_io_header header;
+  if (source.length < sizeof(header))
+    return BLOX_IO_TRUNCATED;
+  memcpy(&header, bytes, sizeof(header));
+  int status = blox_io_check_(&header, BLOX_IO_FLAT, width);
+  if (status != BLOX_IO_OK)
+    return status;
+  size_t start = blox_io__round(sizeof(header), header.alignment);
+  if (source.length < start || header.length > (source.length - start) / width)
+    return BLOX_IO_TRUNCATED;
+  if ((uintptr_t)(bytes + start) % natural)
+    return BLOX_IO_MISALIGNED;
+  if (verify && blox_io_checksum_(bytes + start, header.length * width) !=
+                    header.checksum)
+    return BLOX_IO_CORRUPTED;
+  *target = blox_use_(bytes + start, (size_t)header.length);
+  return BLOX_IO_OK;
+}
+
+/*
+ Largest power of two dividing sizeof(TYPE), which is what its alignment
+ can be at most
+*/
+#define blox_io__natural(TYPE) (sizeof(TYPE) & (~sizeof(TYPE) + 1))
+
+#define blox_io_load(TYPE, source, target) \
+  blox_io_load_(source, &(target), sizeof(TYPE), blox_io__natural(TYPE), 1)
+
+/*
+ Same as `blox_io_load`, but skips verifying the checksum (which has to
+ touch every byte)
+*/
+#define blox_io_load_trusted(TYPE, source, target) \
+  blox_io_load_(source, &(target), sizeof(TYPE), blox_io__natural(TYPE), 0)
+
+/*
+ Zero-copy view of a serialized container of containers
+*/
+typedef struct {
+  blox offsets;
+  blox elements;
+} blox_io_nested;
+
+int blox_io_load_nested_(blox source,
+                         blox_io_nested* target,
+                         size_t width,
+                         size_t natural,
+                         int verify) {
+  const char* bytes = (const char*)source.data;
+  blox_io_header header;
+  if (source.length < sizeof(header))
+    return BLOX_IO_TRUNCATED;
+  memcpy(&header, bytes, sizeof(header));
+  int status = blox_io_check_(&header, BLOX_IO_NESTED, width);
+  if (status != BLOX_IO_OK)
+    return status;
+  size_t available = (source.length - sizeof(header)) / sizeof(uint64_t);
+  if (header.length >= available)
+    return BLOX_IO_TRUNCATED;
+  size_t count = (size_t)header.length + 1;
+  const char* table = bytes + sizeof(header);
+  if ((uintptr_t)table % sizeof(uint64_t))
+    return BLOX_IO_MISALIGNED;
+  const uint64_t* offsets = (const uint64_t*)table;
+  size_t start = blox_io__round(sizeof(header) + count * sizeof(uint64_t),
+                                header.alignment);
+  uint64_t total = offsets[count - 1];
+  if (source.length < start || total > (source.length - start) / width)
+    return BLOX_IO_TRUNCATED;
+  for (size_t index = 1; index < count; ++index)
+    if (offsets[index] < offsets[index - 1])
+      return BLOX_IO_CORRUPTED;
+  if ((uintptr_t)(bytes + start) % natural)
+    return BLOX_IO_MISALIGNED;
+  if (verify) {
+    blox_io_checksum sum;
+    blox_io_checksum_init_(&sum);
+    blox_io_checksum_update_(&sum, offsets, count * sizeof(uint64_t));
+    blox_io_checksum_update_(&sum, bytes + start, (size_t)total * width);
+    if (blox_io_checksum_final_(&sum) != header.checksum)
+      return BLOX_IO_CORRUPTED;
+  }
+  target->offsets = blox_use_(offsets, count);
+  target->elements = blox_use_(bytes + start, (size_t)total);
+  return BLOX_IO_OK;
+}
+
+#define blox_io_load_nested(TYPE, source, target)                    \
+  blox_io_load_nested_(source, &(target), sizeof(TYPE),              \
+                       blox_io__natural(TYPE), 1)
+
+#define blox_io_nested_length(nested) ((nested).offsets.length - 1)
+
+/*
+ Returns a view of the `index`th inner container
+*/
+#define blox_io_nested_get(TYPE, nested, index)                          \
+  blox_use_(blox_index(TYPE, (nested).elements,                          \
+                       blox_get(uint64_t, (nested).offsets, index)),     \
+            (size_t)(blox_get(uint64_t, (nested).offsets, (index) + 1) - \
+                     blox_get(uint64_t, (nested).offsets, index)))
+
+#endif  // BLOX_IO_H_INCLUDED
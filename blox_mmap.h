@@ -0,0 +1,244 @@
+/* Blox Array Library - File Mappings
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_MMAP_H_INCLUDED
+#define BLOX_MMAP_H_INCLUDED
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "blox.h"
+
+enum {
+  BLOX_MAP_NORMAL = POSIX_MADV_NORMAL,
+  BLOX_MAP_SEQUENTIAL = POSIX_MADV_SEQUENTIAL,
+  BLOX_MAP_RANDOM = POSIX_MADV_RANDOM,
+  BLOX_MAP_WILLNEED = POSIX_MADV_WILLNEED,
+  BLOX_MAP_DONTNEED = POSIX_MADV_DONTNEED
+};
+
+/*
+ A file mapped into memory. Writable mappings act as the heap of exactly
+ one container: growing it extends the file (`ftruncate`) and remaps it
+ (`mremap` where available), so elements are never copied. The mapping
+ must not be moved while in use, as its heap refers to it. After a failed
+ open `fd` is -1.
+*/
+typedef struct {
+  blox_heap heap;
+  int fd;
+  void* base;
+  size_t size;
+  int advice;
+} blox_mapping;
+
+void* blox_map_region_(blox_mapping* map, size_t size, int writable) {
+  void* base = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED, map->fd, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+  if (map->advice != BLOX_MAP_NORMAL)
+    posix_madvise(base, size, map->advice);
+  map->base = base;
+  map->size = size;
+  return base;
+}
+
+void* blox_map_allocate_(void* context, size_t size, size_t alignment) {
+  blox_mapping* map = (blox_mapping*)context;
+  (void)alignment;
+  if (ftruncate(map->fd, (off_t)size) != 0)
+    return NULL;
+  return blox_map_region_(map, size, 1);
+}
+
+void* blox_map_reallocate_(void* context,
+                           void* data,
+                           size_t size,
+                           size_t request,
+                           size_t alignment) {
+  blox_mapping* map = (blox_mapping*)context;
+  (void)data;
+  (void)size;
+  (void)alignment;
+  if (ftruncate(map->fd, (off_t)request) != 0)
+    return NULL;
+#ifdef MREMAP_MAYMOVE
+  void* base = mremap(map->base, map->size, request, MREMAP_MAYMOVE);
+  if (base == MAP_FAILED)
+    return NULL;
+  if (map->advice != BLOX_MAP_NORMAL)
+    posix_madvise(base, request, map->advice);
+  map->base = base;
+  map->size = request;
+  return base;
+#else
+  /*
+   The pages belong to the file, so remapping doesn't copy anything; the
+   old mapping stays in place until the new one has succeeded
+  */
+  void* previous = map->base;
+  size_t mapped = map->size;
+  void* base = blox_map_region_(map, request, 1);
+  if (base != NULL)
+    munmap(previous, mapped);
+  return base;
+#endif
+}
+
+void blox_map_release_(void* context, void* data) {
+  blox_mapping* map = (blox_mapping*)context;
+  (void)data;
+  munmap(map->base, map->size);
+  map->base = NULL;
+  map->size = 0;
+}
+
+int blox_map_open_(blox_mapping* map, const char* path, int writable) {
+  struct stat info;
+  map->heap.allocate = blox_map_allocate_;
+  map->heap.reallocate = blox_map_reallocate_;
+  map->heap.release = blox_map_release_;
+  map->heap.context = map;
+  map->heap.alignment = 0;
+  map->heap.growth = blox_grow_pages;
+  map->base = NULL;
+  map->size = 0;
+  map->advice = BLOX_MAP_NORMAL;
+  if (writable)
+    map->fd = open(path, O_RDWR | O_CREAT, 0644);
+  else
+    map->fd = open(path, O_RDONLY);
+  if (map->fd < 0)
+    return 0;
+  if (fstat(map->fd, &info) == 0) {
+    map->size = (size_t)info.st_size;
+    return 1;
+  }
+  close(map->fd);
+  map->fd = -1;
+  return 0;
+}
+
+/*
+ Opens (or creates) a file of `width`-sized elements for reading and
+ writing; the returned container may be modified and grown like any
+ other, but must be closed with `blox_map_close` rather than freed. Fails
+ if the file's size isn't a multiple of `width`. While open, the file
+ holds an extra zeroed element (the container's terminator) past the end,
+ which other readers will see; closing removes it.
+*/
+blox blox_map_file_(blox_mapping* map, const char* path, size_t width) {
+  blox buffer = {0};
+  if (!blox_map_open_(map, path, 1))
+    return buffer;
+  if (map->size % width != 0) {
+    close(map->fd);
+    map->fd = -1;
+    map->size = 0;
+    return buffer;
+  }
+  size_t length = map->size / width;
+  map->size = 0;
+  buffer.heap = &map->heap;
+  if (!blox_reserve_(&buffer, width, length)) {
+    close(map->fd);
+    map->fd = -1;
+    return blox_nil();
+  }
+  buffer.length = length;
+  memset((char*)buffer.data + length * width, 0, width);
+  return buffer;
+}
+
+/*
+ Maps an existing file read-only; the container is a view like those
+ returned by `blox_use` (modifying it copies the elements to the heap)
+*/
+blox blox_map_view_(blox_mapping* map, const char* path, size_t width) {
+  if (!blox_map_open_(map, path, 0))
+    return blox_nil();
+  size_t length = map->size / width;
+  if (length == 0 || blox_map_region_(map, map->size, 0) == NULL) {
+    close(map->fd);
+    map->fd = -1;
+    map->size = 0;
+    return blox_nil();
+  }
+  return blox_use_(map->base, length);
+}
+
+/*
+ Trims the file to the container's length (dropping the terminator, so an
+ unmodified file gets back its original size), then unmaps and closes it;
+ returns 0 if the file couldn't be trimmed
+*/
+int blox_map_close_(blox_mapping* map, blox* buffer, size_t width) {
+  int trimmed = 1;
+  if (map->fd < 0)
+    return 0;
+  if (map->base != NULL)
+    munmap(map->base, map->size);
+  if (buffer->heap == &map->heap) {
+    trimmed = ftruncate(map->fd, (off_t)(buffer->length * width)) == 0;
+    *buffer = blox_nil();
+  } else if (buffer->data != NULL && buffer->data == map->base)
+    *buffer = blox_nil();
+  close(map->fd);
+  map->fd = -1;
+  map->base = NULL;
+  map->size = 0;
+  return trimmed;
+}
+
+/*
+ Flushes modified pages to the file (waiting for completion if `wait`)
+*/
+int blox_map_sync(blox_mapping* map, int wait) {
+  if (map->base == NULL)
+    return 1;
+  return msync(map->base, map->size, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+/*
+ Hints the expected access pattern (one of the BLOX_MAP_* constants); the
+ hint is reapplied whenever the mapping grows
+*/
+int blox_map_advise(blox_mapping* map, int advice) {
+  map->advice = advice;
+  if (map->base == NULL)
+    return 1;
+  return posix_madvise(map->base, map->size, advice) == 0;
+}
+
+#define blox_map_file(TYPE, map, path) blox_map_file_(map, path, sizeof(TYPE))
+
+#define blox_map_view(TYPE, map, path) blox_map_view_(map, path, sizeof(TYPE))
+
+#define blox_map_close(TYPE, map, buffer) \
+  blox_map_close_(map, &(buffer), sizeof(TYPE))
+
+#endif  // BLOX_MMAP_H_INCLUDED
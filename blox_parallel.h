@@ -0,0 +1,460 @@
+/* Blox Array Library - Parallel Algorithms
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_PARALLEL_H_INCLUDED
+#define BLOX_PARALLEL_H_INCLUDED
+
+/*
+ Requires POSIX threads (link with -pthread)
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include "blox.h"
+
+#ifndef BLOX_PARALLEL_THRESHOLD
+#define BLOX_PARALLEL_THRESHOLD 65536
+#endif
+
+typedef void (*blox_task)(void* context, size_t index, size_t worker);
+
+/*
+ Fixed set of worker threads which cooperatively run the indices
+ [0, total) of one task at a time; the calling thread participates as the
+ last worker
+*/
+typedef struct blox_pool {
+  blox threads;
+  blox slots;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  blox_task task;
+  void* context;
+  size_t total;
+  size_t next;
+  size_t finished;
+  size_t generation;
+  int stop;
+} blox_pool;
+
+typedef struct {
+  blox_pool* pool;
+  size_t worker;
+} blox_pool_slot_;
+
+/*
+ Grabs indices of the current task until there are none left; called (and
+ returns) with the lock held
+*/
+void blox_pool_drain_(blox_pool* pool, size_t worker) {
+  while (pool->next < pool->total) {
+    size_t index = pool->next++;
+    blox_task task = pool->task;
+    void* context = pool->context;
+    pthread_mutex_unlock(&pool->lock);
+    task(context, index, worker);
+    pthread_mutex_lock(&pool->lock);
+    if (++pool->finished == pool->total)
+      pthread_cond_broadcast(&pool->done);
+  }
+}
+
+void* blox_pool_worker_(void* argument) {
+  blox_pool_slot_* slot = (blox_pool_slot_*)argument;
+  blox_pool* pool = slot->pool;
+  size_t seen = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stop && pool->generation == seen)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    if (pool->stop)
+      break;
+    seen = pool->generation;
+    blox_pool_drain_(pool, slot->worker);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/*
+ Starts `threads` workers (0 means one per online CPU, minus the caller)
+*/
+blox_pool* blox_pool_create(size_t threads) {
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 1 ? (size_t)online - 1 : 0;
+  }
+  blox_pool* pool = (blox_pool*)blox_realloc(NULL)(NULL, sizeof(blox_pool));
+  if (pool == NULL)
+    return NULL;
+  memset(pool, 0, sizeof(blox_pool));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->threads = blox_reserved(pthread_t, threads);
+  pool->slots = blox_make(blox_pool_slot_, threads);
+  for (size_t index = 0; index < pool->slots.length; ++index) {
+    blox_pool_slot_* slot = blox_index(blox_pool_slot_, pool->slots, index);
+    slot->pool = pool;
+    slot->worker = index;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, blox_pool_worker_, slot) != 0)
+      break;
+    blox_push(pthread_t, pool->threads, thread);
+  }
+  return pool;
+}
+
+void blox_pool_free(blox_pool* pool) {
+  if (pool == NULL)
+    return;
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t index = 0; index < pool->threads.length; ++index)
+    pthread_join(blox_get(pthread_t, pool->threads, index), NULL);
+  blox_free(pool->threads);
+  blox_free(pool->slots);
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  blox_realloc(NULL)(pool, 0);
+}
+
+/*
+ Number of distinct `worker` values a task may see (threads + caller)
+*/
+size_t blox_pool_workers(blox_pool* pool) {
+  return pool ? pool->threads.length + 1 : 1;
+}
+
+/*
+ Runs `task` for every index in [0, total) and waits for completion
+*/
+void blox_pool_run(blox_pool* pool, size_t total, blox_task task, void* context) {
+  if (pool == NULL || pool->threads.length == 0) {
+    for (size_t index = 0; index < total; ++index)
+      task(context, index, 0);
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->context = context;
+  pool->total = total;
+  pool->next = 0;
+  pool->finished = 0;
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->wake);
+  blox_pool_drain_(pool, pool->threads.length);
+  while (pool->finished < pool->total)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ Splits `length` elements into chunks of at least BLOX_PARALLEL_THRESHOLD
+ (a few per worker); returns the chunk size
+*/
+size_t blox_parallel_chunk_(blox_pool* pool, size_t length) {
+  size_t chunk = length / (blox_pool_workers(pool) * 4) + 1;
+  return chunk < BLOX_PARALLEL_THRESHOLD ? BLOX_PARALLEL_THRESHOLD : chunk;
+}
+
+typedef struct {
+  unsigned char* data;
+  size_t length;
+  size_t width;
+  size_t chunk;
+  void* action;
+  unsigned char* userdata;
+  size_t stride;
+} blox_parallel_apply_context_;
+
+void blox_parallel_apply_task_(void* argument, size_t index, size_t worker) {
+  typedef void (*indexed)(const void*, size_t);
+  typedef void (*visitor)(const void*, void*);
+  blox_parallel_apply_context_* context =
+      (blox_parallel_apply_context_*)argument;
+  size_t start = index * context->chunk;
+  size_t end = start + context->chunk;
+  if (end > context->length)
+    end = context->length;
+  unsigned char* current = context->data + start * context->width;
+  if (context->stride == 0) {
+    indexed step = (indexed)context->action;
+    for (; start < end; ++start, current += context->width)
+      step(current, start);
+  } else {
+    visitor step = (visitor)context->action;
+    void* userdata = context->userdata + worker * context->stride;
+    for (; start < end; ++start, current += context->width)
+      step(current, userdata);
+  }
+}
+
+/*
+ A zero `stride` selects for-each style callbacks (element, index),
+ otherwise visit style callbacks (element, per-worker userdata)
+*/
+void blox_parallel_apply_(blox_pool* pool,
+                          void* data,
+                          size_t length,
+                          size_t width,
+                          void* action,
+                          void* userdata,
+                          size_t stride) {
+  blox_parallel_apply_context_ context = {
+      (unsigned char*)data, length, width, 0, action,
+      (unsigned char*)userdata, stride};
+  context.chunk = blox_parallel_chunk_(pool, length);
+  if (length <= context.chunk) {
+    context.chunk = length;
+    blox_parallel_apply_task_(&context, 0, 0);
+    return;
+  }
+  blox_pool_run(pool, (length + context.chunk - 1) / context.chunk,
+                blox_parallel_apply_task_, &context);
+}
+
+#define blox_parallel_for_each(TYPE, buffer, action, pool)                 \
+  blox_parallel_apply_(pool, (buffer).data, (buffer).length, sizeof(TYPE), \
+                       (void*)action, NULL, 0)
+
+/*
+ `userdata` is a blox of USERTYPE with (at least) `blox_pool_workers(pool)`
+ elements; each worker only ever touches its own element
+*/
+#define blox_parallel_visit(TYPE, buffer, action, USERTYPE, userdata, pool) \
+  blox_parallel_apply_(pool, (buffer).data, (buffer).length, sizeof(TYPE),  \
+                       (void*)action, (userdata).data, sizeof(USERTYPE))
+
+typedef void (*blox_reduction)(void* accumulator, const void* element);
+
+typedef void (*blox_combination)(void* accumulator, const void* other);
+
+typedef struct {
+  unsigned char* data;
+  size_t length;
+  size_t width;
+  size_t chunk;
+  unsigned char* partials;
+  size_t result_width;
+  blox_reduction step;
+} blox_parallel_reduce_context_;
+
+void blox_parallel_reduce_task_(void* argument, size_t index, size_t worker) {
+  blox_parallel_reduce_context_* context =
+      (blox_parallel_reduce_context_*)argument;
+  (void)worker;
+  size_t start = index * context->chunk;
+  size_t end = start + context->chunk;
+  if (end > context->length)
+    end = context->length;
+  void* accumulator = context->partials + index * context->result_width;
+  unsigned char* current = context->data + start * context->width;
+  for (; start < end; ++start, current += context->width)
+    context->step(accumulator, current);
+}
+
+/*
+ Each chunk is reduced into its own copy of `result`, so on entry it must
+ hold the identity of `combine` (0 for a sum, 1 for a product, ...), or a
+ starting value would be counted once per chunk. Partial results are then
+ combined in order, so the outcome doesn't depend on scheduling.
+*/
+void blox_parallel_reduce_(blox_pool* pool,
+                           const void* data,
+                           size_t length,
+                           size_t width,
+                           void* result,
+                           size_t result_width,
+                           blox_reduction step,
+                           blox_combination combine) {
+  blox_parallel_reduce_context_ context = {
+      (unsigned char*)data, length, width, 0, NULL, result_width, step};
+  context.chunk = blox_parallel_chunk_(pool, length);
+  size_t chunks = (length + context.chunk - 1) / context.chunk;
+  blox partials = {0};
+  if (chunks < 2 || !blox_reserve_(&partials, result_width, chunks)) {
+    const unsigned char* current = (const unsigned char*)data;
+    for (size_t index = 0; index < length; ++index, current += width)
+      step(result, current);
+    blox_free(partials);
+    return;
+  }
+  context.partials = (unsigned char*)partials.data;
+  for (size_t index = 0; index < chunks; ++index)
+    memcpy(context.partials + index * result_width, result, result_width);
+  blox_pool_run(pool, chunks, blox_parallel_reduce_task_, &context);
+  memcpy(result, context.partials, result_width);
+  for (size_t index = 1; index < chunks; ++index)
+    combine(result, context.partials + index * result_width);
+  blox_free(partials);
+}
+
+#define blox_parallel_reduce(TYPE, buffer, RESULT, result, step, combine, pool) \
+  blox_parallel_reduce_(pool, (buffer).data, (buffer).length, sizeof(TYPE),     \
+                        &(result), sizeof(RESULT), (blox_reduction)step,        \
+                        (blox_combination)combine)
+
+typedef struct {
+  size_t start;
+  size_t middle;
+  size_t end;
+  size_t from;
+  size_t to;
+} blox_parallel_merge_;
+
+typedef struct {
+  unsigned char* source;
+  unsigned char* target;
+  size_t length;
+  size_t width;
+  size_t chunk;
+  blox_comparison comparison;
+  blox merges;
+} blox_parallel_sort_context_;
+
+void blox_parallel_sort_task_(void* argument, size_t index, size_t worker) {
+  blox_parallel_sort_context_* context =
+      (blox_parallel_sort_context_*)argument;
+  (void)worker;
+  size_t start = index * context->chunk;
+  size_t end = start + context->chunk;
+  if (end > context->length)
+    end = context->length;
+  qsort(context->source + start * context->width, end - start, context->width,
+        context->comparison);
+}
+
+/*
+ Number of elements of `left` that come before position `rank` of the
+ (stable) merge of `left` and `right`
+*/
+size_t blox_parallel_corank_(const unsigned char* left,
+                             size_t left_length,
+                             const unsigned char* right,
+                             size_t right_length,
+                             size_t rank,
+                             size_t width,
+                             blox_comparison comparison) {
+  size_t low = rank > right_length ? rank - right_length : 0;
+  size_t high = rank < left_length ? rank : left_length;
+  while (low < high) {
+    size_t taken = low + (high - low) / 2;
+    if (comparison(right + (rank - taken - 1) * width, left + taken * width) <
+        0)
+      high = taken;
+    else
+      low = taken + 1;
+  }
+  return low;
+}
+
+void blox_parallel_merge_task_(void* argument, size_t index, size_t worker) {
+  blox_parallel_sort_context_* context =
+      (blox_parallel_sort_context_*)argument;
+  (void)worker;
+  blox_parallel_merge_* merge =
+      blox_index(blox_parallel_merge_, context->merges, index);
+  size_t width = context->width;
+  const unsigned char* left = context->source + merge->start * width;
+  const unsigned char* right = context->source + merge->middle * width;
+  size_t left_length = merge->middle - merge->start;
+  size_t right_length = merge->end - merge->middle;
+  size_t from = blox_parallel_corank_(left, left_length, right, right_length,
+                                      merge->from, width, context->comparison);
+  size_t to = blox_parallel_corank_(left, left_length, right, right_length,
+                                    merge->to, width, context->comparison);
+  size_t lhs = from, rhs = merge->from - from;
+  size_t left_end = to, right_end = merge->to - to;
+  unsigned char* output = context->target + (merge->start + merge->from) * width;
+  while (lhs < left_end && rhs < right_end) {
+    if (context->comparison(right + rhs * width, left + lhs * width) < 0)
+      memcpy(output, right + rhs++ * width, width);
+    else
+      memcpy(output, left + lhs++ * width, width);
+    output += width;
+  }
+  memcpy(output, left + lhs * width, (left_end - lhs) * width);
+  output += (left_end - lhs) * width;
+  memcpy(output, right + rhs * width, (right_end - rhs) * width);
+}
+
+/*
+ Sorts chunks with qsort in parallel, then merges pairs of runs, each
+ merge being split into pieces so all workers stay busy
+*/
+void blox_parallel_sort_(blox_pool* pool,
+                         void* data,
+                         size_t length,
+                         size_t width,
+                         blox_comparison comparison) {
+  blox_parallel_sort_context_ context = {
+      (unsigned char*)data, NULL, length, width, 0, comparison, {0}};
+  context.chunk = blox_parallel_chunk_(pool, length);
+  size_t chunks = (length + context.chunk - 1) / context.chunk;
+  blox scratch = {0};
+  if (chunks < 2 || pool == NULL ||
+      !blox_reserve_(&scratch, width, length)) {
+    qsort(data, length, width, comparison);
+    blox_free(scratch);
+    return;
+  }
+  context.target = (unsigned char*)scratch.data;
+  blox_pool_run(pool, chunks, blox_parallel_sort_task_, &context);
+  size_t piece = context.chunk;
+  for (size_t run = context.chunk; run < length; run *= 2) {
+    blox_shrink(blox_parallel_merge_, context.merges);
+    for (size_t start = 0; start < length; start += 2 * run) {
+      blox_parallel_merge_ merge;
+      merge.start = start;
+      merge.middle = start + run < length ? start + run : length;
+      merge.end = merge.middle + run < length ? merge.middle + run : length;
+      size_t total = merge.end - merge.start;
+      for (merge.from = 0; merge.from < total; merge.from = merge.to) {
+        merge.to = merge.from + piece < total ? merge.from + piece : total;
+        blox_push(blox_parallel_merge_, context.merges, merge);
+      }
+    }
+    blox_pool_run(pool, context.merges.length, blox_parallel_merge_task_,
+                  &context);
+    unsigned char* swap = context.source;
+    context.source = context.target;
+    context.target = swap;
+  }
+  if (context.source != (unsigned char*)data)
+    memcpy(data, context.source, length * width);
+  blox_free(context.merges);
+  blox_free(scratch);
+}
+
+#define blox_parallel_sort(TYPE, buffer, comparison, pool)                \
+  blox_parallel_sort_(pool, (buffer).data, (buffer).length, sizeof(TYPE), \
+                      (blox_comparison)comparison)
+
+#endif  // BLOX_PARALLEL_H_INCLUDED
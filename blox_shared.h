@@ -0,0 +1,249 @@
+/* Blox Array Library - Shared Buffers
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_SHARED_H_INCLUDED
+#define BLOX_SHARED_H_INCLUDED
+
+#include "blox.h"
+#include "blox_concurrent.h"
+
+typedef struct {
+  size_t references;
+  blox storage;
+} blox_shared_block_;
+
+/*
+ Reference counted buffer: any number of `blox_shared` handles (whole
+ buffers or slices of one) share a single `storage`, which is freed when
+ the last handle is released. Slicing is O(1). The first write through a
+ handle whose storage is also referenced elsewhere copies just the
+ elements it sees (copy-on-write). Counts are updated atomically, so
+ handles may be passed between threads.
+*/
+typedef struct {
+  blox view;
+  blox_shared_block_* block;
+} blox_shared;
+
+#define blox_shared_view(shared) (shared).view
+
+#define blox_shared_length(shared) (shared).view.length
+
+#define blox_shared_empty(shared) (blox_shared_length(shared) == 0)
+
+#define blox_shared_get(TYPE, shared, index) \
+  blox_get(TYPE, (shared).view, index)
+
+#define blox_shared_references(shared) \
+  ((shared).block ? blox_atomic_load_(&(shared).block->references) : 0)
+
+/*
+ Wraps `storage` (taking ownership of it) in a block with one reference.
+ Blocks always come from the default heap: the storage's own heap may
+ serve a single container (file mappings) or hand out whole pages.
+*/
+blox_shared blox_shared_adopt_(blox storage) {
+  blox_shared shared = {{0}, NULL};
+  blox_heap* heap = blox_default_heap();
+  blox_shared_block_* block = (blox_shared_block_*)heap->allocate(
+      heap->context, sizeof(blox_shared_block_), 0);
+  if (block == NULL) {
+    blox_free(storage);
+    return shared;
+  }
+  block->references = 1;
+  block->storage = storage;
+  shared.block = block;
+  shared.view = blox_use_(storage.data, storage.length);
+  return shared;
+}
+
+/*
+ Moves an owned blox into a new shared buffer without copying (views are
+ copied, since their storage belongs to someone else)
+*/
+blox_shared blox_share_(blox* buffer, size_t width) {
+  blox storage = *buffer;
+  if (storage.heap == blox_borrowed_heap())
+    storage = blox_clone_(width, storage.data, storage.length);
+  blox_drop(*buffer);
+  return blox_shared_adopt_(storage);
+}
+
+#define blox_share(TYPE, buffer) \
+  BLOX__SITED(blox_share_(&(buffer), sizeof(TYPE)))
+
+#define blox_shared_copy(shared) blox_shared_retain_(&(shared))
+
+blox_shared blox_shared_retain_(const blox_shared* shared) {
+  if (shared->block != NULL)
+    blox_atomic_add_(&shared->block->references, 1);
+  return *shared;
+}
+
+void blox_shared_release_(blox_shared* shared) {
+  blox_shared_block_* block = shared->block;
+  if (block != NULL &&
+      blox_atomic_add_(&block->references, (size_t)-1) == 1) {
+    blox_heap* heap = blox_default_heap();
+    blox_free(block->storage);
+    heap->release(heap->context, block);
+  }
+  shared->view = blox_nil();
+  shared->block = NULL;
+}
+
+#define blox_shared_free(shared) blox_shared_release_(&(shared))
+
+/*
+ New handle on `amount` elements starting at `start` (clamped to the
+ elements of `shared`), sharing its storage
+*/
+blox_shared blox_shared_slice_(const blox_shared* shared,
+                               size_t width,
+                               size_t start,
+                               size_t amount) {
+  size_t length = shared->view.length;
+  if (start > length)
+    start = length;
+  if (amount > length - start)
+    amount = length - start;
+  blox_shared slice = blox_shared_retain_(shared);
+  slice.view = blox_use_((unsigned char*)shared->view.data + start * width,
+                         amount);
+  return slice;
+}
+
+#define blox_shared_slice(TYPE, shared, start, amount) \
+  blox_shared_slice_(&(shared), sizeof(TYPE), start, amount)
+
+#define blox_shared_slice_range(TYPE, shared, start, end) \
+  blox_shared_slice(TYPE, shared, start, blox__safe_subtract(end, start))
+
+#define blox_shared_slice_first(TYPE, shared, amount) \
+  blox_shared_slice(TYPE, shared, 0, amount)
+
+#define blox_shared_slice_last(TYPE, shared, amount) \
+  blox_shared_slice(TYPE, shared,                    \
+                    blox__safe_subtract((shared).view.length, amount), amount)
+
+/*
+ Makes `shared` the sole owner of a storage holding exactly its elements,
+ copying them to the current heap if the storage is referenced by other
+ handles too (or just moving them to the front if it isn't); returns 0 if
+ memory ran out
+*/
+int blox_shared_unique_(blox_shared* shared, size_t width) {
+  typedef unsigned char byte;
+  blox_shared_block_* block = shared->block;
+  size_t length = shared->view.length;
+  if (block != NULL && blox_atomic_load_(&block->references) == 1) {
+    blox* storage = &block->storage;
+    if (shared->view.data != storage->data) {
+      BLOX__STAT(MOVED, length * width);
+      memmove(storage->data, shared->view.data, length * width);
+    }
+    if (storage->length != length) {
+      memset((byte*)storage->data + length * width, 0, width);
+      storage->length = length;
+    }
+    return 1;
+  }
+  blox copy = {0};
+  if (!blox_reserve_(&copy, width, length))
+    return 0;
+  if (length != 0) {
+    BLOX__STAT(MOVED, length * width);
+    memcpy(copy.data, shared->view.data, length * width);
+  }
+  memset((byte*)copy.data + length * width, 0, width);
+  copy.length = length;
+  blox_shared fresh = blox_shared_adopt_(copy);
+  if (fresh.block == NULL)
+    return 0;
+  blox_shared_release_(shared);
+  *shared = fresh;
+  return 1;
+}
+
+void blox_shared_sync_(blox_shared* shared) {
+  blox* storage = &shared->block->storage;
+  shared->view = blox_use_(storage->data, storage->length);
+}
+
+#define blox_shared__storage(shared) (&(shared).block->storage)
+
+/*
+ Runs `action` (a statement using `storage`, a `blox*` holding exactly the
+ elements of `shared`, with nobody else referencing it) and refreshes the
+ handle afterwards
+*/
+#define blox_shared_edit(TYPE, shared, storage, action) \
+  do {                                                  \
+    BLOX__STAT_SITE();                                  \
+    if (!blox_shared_unique_(&(shared), sizeof(TYPE)))  \
+      break;                                            \
+    blox* storage = blox_shared__storage(shared);       \
+    action;                                             \
+    blox_shared_sync_(&(shared));                       \
+  } while (0)
+
+#define blox_shared_set(TYPE, shared, index, value) \
+  blox_shared_edit(TYPE, shared, storage,           \
+                   blox_set(TYPE, *storage, index, value))
+
+#define blox_shared_resize(TYPE, shared, size) \
+  blox_shared_edit(TYPE, shared, storage, blox_resize(TYPE, *storage, size))
+
+#define blox_shared_push(TYPE, shared, value) \
+  blox_shared_edit(TYPE, shared, storage, blox_push(TYPE, *storage, value))
+
+#define blox_shared_pop(TYPE, shared) \
+  blox_shared_edit(TYPE, shared, storage, blox_pop(TYPE, *storage))
+
+#define blox_shared_append(TYPE, shared, other) \
+  blox_shared_edit(TYPE, shared, storage, blox_append(TYPE, *storage, other))
+
+/*
+ Turns the handle into an ordinary blox (copying only if the storage is
+ shared or the handle is a slice), leaving `shared` empty
+*/
+blox blox_unshare_(blox_shared* shared, size_t width) {
+  blox result = {0};
+  if (shared->block == NULL || !blox_shared_unique_(shared, width))
+    return result;
+  blox_shared_block_* block = shared->block;
+  blox_heap* heap = blox_default_heap();
+  result = block->storage;
+  heap->release(heap->context, block);
+  shared->view = blox_nil();
+  shared->block = NULL;
+  return result;
+}
+
+#define blox_unshare(TYPE, shared) \
+  BLOX__SITED(blox_unshare_(&(shared), sizeof(TYPE)))
+
+#endif  // BLOX_SHARED_H_INCLUDED
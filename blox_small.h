@@ -0,0 +1,121 @@
+/* Blox Array Library - Small Buffers
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_SMALL_H_INCLUDED
+#define BLOX_SMALL_H_INCLUDED
+
+#include "blox.h"
+
+/*
+ A blox with N bytes of inline storage. While the elements fit, they live
+ inside the object itself (no allocation, no pointer to chase); once they
+ don't, they spill to the current heap through the normal resize path.
+
+ Only the inline case is marked in `box` (by a NULL `data`), so objects
+ remain safe to copy around by value: the working view is rebuilt from
+ the storage on every operation. A zeroed-out object is empty.
+*/
+#define blox_small(N)         \
+  struct {                    \
+    blox box;                 \
+    union {                   \
+      unsigned char bytes[N]; \
+      long double floating;   \
+      long long integer;      \
+      void* pointer;          \
+    } storage;                \
+  }
+
+blox blox_small_view_(const blox* box, void* storage, size_t size, size_t width) {
+  if (box->data != NULL)
+    return *box;
+  blox view = {storage, box->length, size / width, blox_borrowed_heap()};
+  return view;
+}
+
+void blox_small_store_(blox* box, blox view, const void* storage) {
+  if (view.data == storage) {
+    blox inline_ = {NULL, view.length, 0, NULL};
+    *box = inline_;
+  } else
+    *box = view;
+}
+
+#define blox_small_inline(small) ((small).box.data == NULL)
+
+#define blox_small_length(small) (small).box.length
+
+#define blox_small_data(TYPE, small) \
+  ((TYPE*)(blox_small_inline(small) ? (small).storage.bytes : (small).box.data))
+
+#define blox_small_get(TYPE, small, index) \
+  (blox_small_data(TYPE, small)[index])
+
+/*
+ Returns a blox view of the elements, for use with any read-only macro
+ (must ***not*** be freed, and is invalidated by modifications)
+*/
+#define blox_small_view(TYPE, small)                     \
+  blox_small_view_(&(small).box, (small).storage.bytes, \
+                   sizeof((small).storage), sizeof(TYPE))
+
+/*
+ Applies a modifying blox macro, e.g.
+ `blox_small_apply(char, tag, blox_append_string, "text")`
+*/
+#define blox_small_apply(TYPE, small, operation, ...)                   \
+  do {                                                                  \
+    blox small_view = blox_small_view(TYPE, small);                     \
+    operation(TYPE, small_view, __VA_ARGS__);                           \
+    blox_small_store_(&(small).box, small_view, (small).storage.bytes); \
+  } while (0)
+
+#define blox_small_push(TYPE, small, value) \
+  blox_small_apply(TYPE, small, blox_push, value)
+
+#define blox_small_resize(TYPE, small, length) \
+  blox_small_apply(TYPE, small, blox_resize, length)
+
+#define blox_small_append(TYPE, small, other) \
+  blox_small_apply(TYPE, small, blox_append, other)
+
+#define blox_small_append_string(TYPE, small, string) \
+  blox_small_apply(TYPE, small, blox_append_string, string)
+
+#define blox_small_pop(TYPE, small)                                     \
+  do {                                                                  \
+    blox small_view = blox_small_view(TYPE, small);                     \
+    blox_pop(TYPE, small_view);                                         \
+    blox_small_store_(&(small).box, small_view, (small).storage.bytes); \
+  } while (0)
+
+#define blox_small_free(small)                                    \
+  do {                                                            \
+    blox_free((small).box);                                       \
+    (small).box.heap = NULL;                                      \
+    memset((small).storage.bytes, 0, sizeof((small).storage));    \
+  } while (0)
+
+#endif  // BLOX_SMALL_H_INCLUDED
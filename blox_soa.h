@@ -0,0 +1,311 @@
+/* Blox Array Library - Struct of Arrays
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_SOA_H_INCLUDED
+#define BLOX_SOA_H_INCLUDED
+
+#include "blox.h"
+#include "blox_sort.h"
+
+/*
+ Struct-of-arrays table: each field of a record lives in its own blox
+ `column` (of `widths[column]` bytes per element), and every operation
+ moves all of the columns in lockstep so that they share one length
+*/
+typedef struct {
+  blox columns;
+  blox widths;
+  size_t length;
+} blox_soa;
+
+#define blox_soa_length(table) (table).length
+
+#define blox_soa_empty(table) (blox_soa_length(table) == 0)
+
+#define blox_soa_columns(table) (table).columns.length
+
+#define blox_soa__column(table, column) blox_get(blox, (table).columns, column)
+
+#define blox_soa__width(table, column) blox_get(size_t, (table).widths, column)
+
+#define blox_soa_index(TYPE, table, column, row) \
+  blox_index(TYPE, blox_soa__column(table, column), row)
+
+#define blox_soa_get(TYPE, table, column, row) \
+  (*blox_soa_index(TYPE, table, column, row))
+
+#define blox_soa_set(TYPE, table, column, row, value) \
+  (blox_soa_get(TYPE, table, column, row) = (TYPE)(value))
+
+/*
+ Read-only view of one column, suitable for `blox_find`, `blox_for_each`
+ and friends (invalidated by anything that changes the table's length)
+*/
+#define blox_soa_view(table, column) \
+  blox_use(blox_soa__column(table, column).data, (table).length)
+
+/*
+ Makes room for `request` rows in every column
+*/
+int blox_soa_reserve_(blox_soa* soa, size_t request) {
+  blox* columns = blox_data(blox, soa->columns);
+  size_t* widths = blox_data(size_t, soa->widths);
+  for (size_t column = 0; column < soa->columns.length; ++column)
+    if (!blox_ensure_(&columns[column], widths[column], request))
+      return 0;
+  return 1;
+}
+
+#define blox_soa_reserve(table, size) blox_soa_reserve_(&(table), size)
+
+/*
+ Sets the number of rows, zeroing any newly added ones
+*/
+int blox_soa_resize_(blox_soa* soa, size_t length) {
+  typedef unsigned char byte;
+  if (!blox_soa_reserve_(soa, length))
+    return 0;
+  blox* columns = blox_data(blox, soa->columns);
+  size_t* widths = blox_data(size_t, soa->widths);
+  for (size_t column = 0; column < soa->columns.length; ++column) {
+    blox* buffer = &columns[column];
+    size_t width = widths[column];
+    if (length > soa->length) {
+      memset((byte*)buffer->data + soa->length * width, 0,
+             (length - soa->length + 1) * width);
+      BLOX__STAT(ZEROED, (length - soa->length + 1) * width);
+    } else
+      memset((byte*)buffer->data + length * width, 0, width);
+    buffer->length = length;
+  }
+  soa->length = length;
+  return 1;
+}
+
+#define blox_soa_resize(table, length) blox_soa_resize_(&(table), length)
+
+/*
+ Adds a column of `width` byte elements (zeroed for existing rows) and
+ returns its index, or -1 if memory ran out
+*/
+size_t blox_soa_add_column_(blox_soa* soa, size_t width) {
+  size_t column = soa->columns.length;
+  if (!blox_ensure_(&soa->columns, sizeof(blox), column + 1) ||
+      !blox_ensure_(&soa->widths, sizeof(size_t), column + 1))
+    return (size_t)-1;
+  blox buffer = {0};
+  if (!blox_reserve_(&buffer, width, soa->length))
+    return (size_t)-1;
+  memset(buffer.data, 0, (soa->length + 1) * width);
+  buffer.length = soa->length;
+  blox_set(blox, soa->columns, column, buffer);
+  blox_set(size_t, soa->widths, column, width);
+  ++soa->columns.length;
+  ++soa->widths.length;
+  return column;
+}
+
+#define blox_soa_add_column(TYPE, table) \
+  BLOX__SITED(blox_soa_add_column_(&(table), sizeof(TYPE)))
+
+/*
+ Appends a zeroed row and returns its index, or -1 if memory ran out
+*/
+size_t blox_soa_push_(blox_soa* soa) {
+  size_t row = soa->length;
+  return blox_soa_resize_(soa, row + 1) ? row : (size_t)-1;
+}
+
+#define blox_soa_push(table) BLOX__SITED(blox_soa_push_(&(table)))
+
+#define blox_soa_pop(table) \
+  blox_soa_resize_(&(table), blox__safe_subtract((table).length, 1))
+
+/*
+ Removes `amount` rows starting at `row`, preserving the order of the rest
+*/
+void blox_soa_erase_(blox_soa* soa, size_t row, size_t amount) {
+  typedef unsigned char byte;
+  size_t length = soa->length;
+  if (row >= length)
+    return;
+  if (amount > length - row)
+    amount = length - row;
+  size_t tail = length - row - amount;
+  blox* columns = blox_data(blox, soa->columns);
+  size_t* widths = blox_data(size_t, soa->widths);
+  for (size_t column = 0; column < soa->columns.length; ++column) {
+    byte* data = (byte*)columns[column].data;
+    size_t width = widths[column];
+    memmove(data + row * width, data + (row + amount) * width, tail * width);
+    BLOX__STAT(MOVED, tail * width);
+  }
+  blox_soa_resize_(soa, length - amount);
+}
+
+#define blox_soa_erase_range(table, row, amount) \
+  BLOX__SITED(blox_soa_erase_(&(table), row, amount))
+
+#define blox_soa_erase(table, row) blox_soa_erase_range(table, row, 1)
+
+/*
+ Removes `row` by moving the last row into its place
+*/
+void blox_soa_erase_unstable_(blox_soa* soa, size_t row) {
+  typedef unsigned char byte;
+  if (row >= soa->length)
+    return;
+  size_t last = soa->length - 1;
+  blox* columns = blox_data(blox, soa->columns);
+  size_t* widths = blox_data(size_t, soa->widths);
+  if (row != last)
+    for (size_t column = 0; column < soa->columns.length; ++column) {
+      byte* data = (byte*)columns[column].data;
+      size_t width = widths[column];
+      memcpy(data + row * width, data + last * width, width);
+    }
+  blox_soa_resize_(soa, last);
+}
+
+#define blox_soa_erase_unstable(table, row) \
+  blox_soa_erase_unstable_(&(table), row)
+
+/*
+ Reorders every column so that row `index` of the result is row
+ `order[index]` of the original (`order` must be a permutation). All of
+ the new columns are allocated before any is filled, so on failure the
+ table is left as it was.
+*/
+int blox_soa_permute_(blox_soa* soa, const size_t* order) {
+  typedef unsigned char byte;
+  size_t length = soa->length;
+  size_t count = soa->columns.length;
+  blox* columns = blox_data(blox, soa->columns);
+  size_t* widths = blox_data(size_t, soa->widths);
+  blox staging = {0};
+  if (!blox_reserve_(&staging, sizeof(blox), count))
+    return 0;
+  blox* fresh = blox_data(blox, staging);
+  for (size_t column = 0; column < count; ++column) {
+    fresh[column] = blox_nil();
+    fresh[column].heap = columns[column].heap;
+    if (!blox_reserve_(&fresh[column], widths[column], length)) {
+      while (column--)
+        blox_release_(&fresh[column]);
+      blox_free(staging);
+      return 0;
+    }
+  }
+  for (size_t column = 0; column < count; ++column) {
+    blox* buffer = &columns[column];
+    size_t width = widths[column];
+    byte* source = (byte*)buffer->data;
+    byte* target = (byte*)fresh[column].data;
+    switch (width) {
+      case 4:
+        for (size_t index = 0; index < length; ++index)
+          memcpy(target + index * 4, source + order[index] * 4, 4);
+        break;
+      case 8:
+        for (size_t index = 0; index < length; ++index)
+          memcpy(target + index * 8, source + order[index] * 8, 8);
+        break;
+      default:
+        for (size_t index = 0; index < length; ++index)
+          memcpy(target + index * width, source + order[index] * width,
+                 width);
+    }
+    memset(target + length * width, 0, width);
+    BLOX__STAT(MOVED, length * width);
+    fresh[column].length = length;
+    blox_release_(buffer);
+    *buffer = fresh[column];
+  }
+  blox_free(staging);
+  return 1;
+}
+
+#define blox_soa_permute(table, order) \
+  BLOX__SITED(blox_soa_permute_(&(table), order))
+
+/*
+ Stable sort of all rows by the 1, 2, 4 or 8 byte scalar keys in `column`:
+ (key, row) pairs are radix sorted, then every column is gathered once.
+ Returns 0 if `key_width` isn't the column's width or a supported key size
+*/
+int blox_soa_sort_by_(blox_soa* soa,
+                      size_t column,
+                      size_t key_width,
+                      int kind) {
+  typedef struct {
+    uint64_t key;
+    size_t row;
+  } pair;
+  size_t length = soa->length;
+  if (key_width != blox_soa__width(*soa, column) || key_width > 8 ||
+      (key_width & (key_width - 1)) != 0)
+    return 0;
+  if (length < 2)
+    return 1;
+  blox pairs = {0};
+  if (!blox_reserve_(&pairs, sizeof(pair), length))
+    return 0;
+  const unsigned char* keys = (const unsigned char*)
+      blox_soa__column(*soa, column).data;
+  pair* data = blox_data(pair, pairs);
+  for (size_t row = 0; row < length; ++row) {
+    data[row].key = 0;
+    memcpy(&data[row].key, keys + row * key_width, key_width);
+    data[row].row = row;
+  }
+  int result = blox_radix_sort_(data, length, sizeof(pair),
+                                offsetof(pair, key), key_width, kind);
+  if (result) {
+    size_t* order = (size_t*)data;
+    for (size_t index = 0; index < length; ++index)
+      order[index] = data[index].row;
+    result = blox_soa_permute_(soa, order);
+  }
+  blox_free(pairs);
+  return result;
+}
+
+#define blox_soa_sort_by(KEY, table, column)                   \
+  BLOX__SITED(blox_soa_sort_by_(&(table), column, sizeof(KEY), \
+                                blox__key_kind(KEY)))
+
+#define blox_soa_clear(table) blox_soa_resize_(&(table), 0)
+
+void blox_soa_free_(blox_soa* soa) {
+  for (size_t column = 0; column < soa->columns.length; ++column)
+    blox_free(blox_soa__column(*soa, column));
+  blox_free(soa->columns);
+  blox_free(soa->widths);
+  soa->length = 0;
+}
+
+#define blox_soa_free(table) blox_soa_free_(&(table))
+
+#endif  // BLOX_SOA_H_INCLUDED
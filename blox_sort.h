@@ -0,0 +1,501 @@
+/* Blox Array Library - Sorting
+
+MIT License
+
+Copyright (c) 2021 Sebastian Garth
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BLOX_SORT_H_INCLUDED
+#define BLOX_SORT_H_INCLUDED
+
+#include <stddef.h>
+#include "blox.h"
+
+/*
+ Default ordering for BLOX_DEFINE_SORT; LESS receives pointers to the two
+ elements being compared
+*/
+#define blox_less_than(lhs, rhs) (*(lhs) < *(rhs))
+
+/*
+ Stamps out `void NAME(blox buffer)` (introsort) and
+ `void NAME##_stable(blox buffer)` (merge sort) specialized for TYPE, with
+ LESS inlined into the comparisons
+*/
+#define BLOX_DEFINE_SORT(NAME, TYPE, LESS)                                   \
+  void NAME##_insertion_(TYPE* data, size_t length) {                        \
+    for (size_t index = 1; index < length; ++index) {                        \
+      TYPE value = data[index];                                              \
+      size_t cursor = index;                                                 \
+      for (; cursor && LESS(&value, &data[cursor - 1]); --cursor)            \
+        data[cursor] = data[cursor - 1];                                     \
+      data[cursor] = value;                                                  \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  void NAME##_sift_(TYPE* data, size_t root, size_t length) {                \
+    TYPE value = data[root];                                                 \
+    size_t child;                                                            \
+    while ((child = 2 * root + 1) < length) {                                \
+      if (child + 1 < length && LESS(&data[child], &data[child + 1]))        \
+        ++child;                                                             \
+      if (!LESS(&value, &data[child]))                                       \
+        break;                                                               \
+      data[root] = data[child];                                              \
+      root = child;                                                          \
+    }                                                                        \
+    data[root] = value;                                                      \
+  }                                                                          \
+                                                                             \
+  void NAME##_heapsort_(TYPE* data, size_t length) {                         \
+    for (size_t root = length / 2; root--;)                                  \
+      NAME##_sift_(data, root, length);                                      \
+    while (length > 1) {                                                     \
+      TYPE swap = data[0];                                                   \
+      data[0] = data[--length];                                              \
+      data[length] = swap;                                                   \
+      NAME##_sift_(data, 0, length);                                         \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  void NAME##_introsort_(TYPE* data, size_t length, int depth) {             \
+    TYPE swap;                                                               \
+    while (length > 16) {                                                    \
+      if (depth-- == 0) {                                                    \
+        NAME##_heapsort_(data, length);                                      \
+        return;                                                              \
+      }                                                                      \
+      size_t middle = length / 2, last = length - 1;                         \
+      if (LESS(&data[middle], &data[0]))                                     \
+        swap = data[middle], data[middle] = data[0], data[0] = swap;         \
+      if (LESS(&data[last], &data[middle])) {                                \
+        swap = data[middle], data[middle] = data[last], data[last] = swap;   \
+        if (LESS(&data[middle], &data[0]))                                   \
+          swap = data[middle], data[middle] = data[0], data[0] = swap;       \
+      }                                                                      \
+      TYPE pivot = data[middle];                                             \
+      ptrdiff_t left = -1, right = (ptrdiff_t)length;                        \
+      for (;;) {                                                             \
+        do                                                                   \
+          ++left;                                                            \
+        while (LESS(&data[left], &pivot));                                   \
+        do                                                                   \
+          --right;                                                           \
+        while (LESS(&pivot, &data[right]));                                  \
+        if (left >= right)                                                   \
+          break;                                                             \
+        swap = data[left], data[left] = data[right], data[right] = swap;     \
+      }                                                                      \
+      size_t split = (size_t)right + 1;                                      \
+      if (split < length - split) {                                          \
+        NAME##_introsort_(data, split, depth);                               \
+        data += split;                                                       \
+        length -= split;                                                     \
+      } else {                                                               \
+        NAME##_introsort_(data + split, length - split, depth);              \
+        length = split;                                                      \
+      }                                                                      \
+    }                                                                        \
+    NAME##_insertion_(data, length);                                         \
+  }                                                                          \
+                                                                             \
+  void NAME(blox buffer) {                                                   \
+    int depth = 0;                                                           \
+    for (size_t length = buffer.length; length > 1; length >>= 1)            \
+      depth += 2;                                                            \
+    NAME##_introsort_((TYPE*)buffer.data, buffer.length, depth);             \
+  }                                                                          \
+                                                                             \
+  void NAME##_merge_(const TYPE* source, TYPE* target, size_t start,         \
+                     size_t middle, size_t end) {                            \
+    size_t left = start, right = middle, index = start;                      \
+    while (left < middle && right < end)                                     \
+      target[index++] = LESS(&source[right], &source[left])                  \
+                            ? source[right++]                                \
+                            : source[left++];                                \
+    while (left < middle)                                                    \
+      target[index++] = source[left++];                                      \
+    while (right < end)                                                      \
+      target[index++] = source[right++];                                     \
+  }                                                                          \
+                                                                             \
+  void NAME##_stable(blox buffer) {                                          \
+    TYPE* data = (TYPE*)buffer.data;                                         \
+    size_t length = buffer.length;                                           \
+    size_t run = 32;                                                         \
+    for (size_t start = 0; start < length; start += run)                     \
+      NAME##_insertion_(data + start,                                        \
+                        length - start < run ? length - start : run);        \
+    if (length <= run)                                                       \
+      return;                                                                \
+    blox scratch = {0};                                                      \
+    if (!blox_reserve_(&scratch, sizeof(TYPE), length)) {                    \
+      NAME##_insertion_(data, length);                                       \
+      return;                                                                \
+    }                                                                        \
+    TYPE* source = data;                                                     \
+    TYPE* target = (TYPE*)scratch.data;                                      \
+    for (; run < length; run *= 2) {                                         \
+      for (size_t start = 0; start < length; start += 2 * run) {             \
+        size_t middle = start + run < length ? start + run : length;         \
+        size_t end = middle + run < length ? middle + run : length;          \
+        NAME##_merge_(source, target, start, middle, end);                   \
+      }                                                                      \
+      TYPE* swap = source;                                                   \
+      source = target;                                                       \
+      target = swap;                                                         \
+    }                                                                        \
+    if (source != data)                                                      \
+      memcpy(data, source, length * sizeof(TYPE));                           \
+    blox_free(scratch);                                                      \
+  }
+
+#define BLOX__RADIX_SCATTER(WIDTH)                                            \
+  for (size_t index = 0; index < length; ++index) {                           \
+    const unsigned char* element = source + index * (WIDTH);                  \
+    size_t digit =                                                            \
+        (blox_order_key_(element + offset, key_width, kind) >> shift) & 0xFF; \
+    memcpy(target + counts[digit]++ * (WIDTH), element, (WIDTH));             \
+  }
+
+/*
+ Stable LSD radix sort (one pass per key byte, skipping passes where every
+ key shares the same byte) of elements of `width` bytes, keyed by the
+ `key_width` bytes found at `offset` within each element. Keys must be 1,
+ 2, 4 or 8 bytes wide. Returns 0 (with the elements untouched) for any
+ other key width, or if the scratch buffer couldn't be allocated
+*/
+int blox_radix_sort_(void* data,
+                     size_t length,
+                     size_t width,
+                     size_t offset,
+                     size_t key_width,
+                     int kind) {
+  typedef unsigned char byte;
+  if (key_width != 1 && key_width != 2 && key_width != 4 && key_width != 8)
+    return 0;
+  if (length < 2)
+    return 1;
+  size_t histogram[8][256] = {{0}};
+  byte* source = (byte*)data;
+  for (size_t index = 0; index < length; ++index) {
+    uint64_t key = blox_order_key_(source + index * width + offset, key_width,
+                                   kind);
+    for (size_t pass = 0; pass < key_width; ++pass)
+      ++histogram[pass][(key >> (pass * 8)) & 0xFF];
+  }
+  blox scratch = {0};
+  if (!blox_reserve_(&scratch, width, length))
+    return 0;
+  byte* target = (byte*)scratch.data;
+  for (size_t pass = 0; pass < key_width; ++pass) {
+    size_t* counts = histogram[pass];
+    unsigned shift = (unsigned)pass * 8;
+    size_t first =
+        (blox_order_key_(source + offset, key_width, kind) >> shift) & 0xFF;
+    if (counts[first] == length)
+      continue;
+    for (size_t digit = 0, total = 0; digit < 256; ++digit) {
+      size_t count = counts[digit];
+      counts[digit] = total;
+      total += count;
+    }
+    switch (width) {
+      case 4:
+        BLOX__RADIX_SCATTER(4);
+        break;
+      case 8:
+        BLOX__RADIX_SCATTER(8);
+        break;
+      default:
+        BLOX__RADIX_SCATTER(width);
+    }
+    byte* swap = source;
+    source = target;
+    target = swap;
+  }
+  if (source != (byte*)data)
+    memcpy(data, source, length * width);
+  blox_free(scratch);
+  return 1;
+}
+
+#define blox_radix_sort(TYPE, buffer)                                  \
+  blox_radix_sort_((buffer).data, (buffer).length, sizeof(TYPE), 0,    \
+                   sizeof(TYPE), blox__key_kind(TYPE))
+
+#define blox_radix_sort_by(TYPE, buffer, KEY, member)                   \
+  blox_radix_sort_((buffer).data, (buffer).length, sizeof(TYPE),        \
+                   offsetof(TYPE, member), sizeof(KEY), blox__key_kind(KEY))
+
+/*
+ Operations on containers kept in the order given by `comparison` (which
+ receives pointers to two elements, as with `blox_sort`)
+*/
+
+size_t blox_bound_(const void* key,
+                   const void* data,
+                   size_t length,
+                   size_t width,
+                   blox_comparison comparison,
+                   int upper) {
+  const unsigned char* base = (const unsigned char*)data;
+  size_t first = 0;
+  while (length > 0) {
+    size_t half = length / 2;
+    int order = comparison(base + (first + half) * width, key);
+    if (upper ? order <= 0 : order < 0) {
+      first += half + 1;
+      length -= half + 1;
+    } else
+      length = half;
+  }
+  return first;
+}
+
+#define blox_lower_bound(TYPE, buffer, key, comparison)           \
+  blox_bound_(&key, (buffer).data, (buffer).length, sizeof(TYPE), \
+              (blox_comparison)comparison, 0)
+
+#define blox_upper_bound(TYPE, buffer, key, comparison)           \
+  blox_bound_(&key, (buffer).data, (buffer).length, sizeof(TYPE), \
+              (blox_comparison)comparison, 1)
+
+int blox_is_sorted_(const void* data,
+                    size_t length,
+                    size_t width,
+                    blox_comparison comparison) {
+  const unsigned char* base = (const unsigned char*)data;
+  for (size_t index = 1; index < length; ++index)
+    if (comparison(base + (index - 1) * width, base + index * width) > 0)
+      return 0;
+  return 1;
+}
+
+#define blox_is_sorted(TYPE, buffer, comparison)                \
+  blox_is_sorted_((buffer).data, (buffer).length, sizeof(TYPE), \
+                  (blox_comparison)comparison)
+
+/*
+ Inserts `value` after any equal elements, shifting the tail with a single
+ `memmove`; returns the position or -1 if memory ran out
+*/
+size_t blox_insert_sorted_(blox* buffer,
+                           size_t width,
+                           const void* value,
+                           blox_comparison comparison) {
+  typedef unsigned char byte;
+  size_t length = buffer->length;
+  size_t index =
+      blox_bound_(value, buffer->data, length, width, comparison, 1);
+  if (!blox_ensure_(buffer, width, length + 1))
+    return (size_t)-1;
+  byte* slot = (byte*)buffer->data + index * width;
+  memmove(slot + width, slot, (length - index) * width);
+  BLOX__STAT(MOVED, (length - index) * width);
+  memcpy(slot, value, width);
+  memset((byte*)buffer->data + (length + 1) * width, 0, width);
+  buffer->length = length + 1;
+  return index;
+}
+
+#define blox_insert_sorted(TYPE, buffer, value, comparison)     \
+  BLOX__SITED(blox_insert_sorted_(&(buffer), sizeof(TYPE),      \
+                                  BLOX__TEMPORARY(TYPE, value), \
+                                  (blox_comparison)comparison))
+
+enum {
+  BLOX_MERGE,
+  BLOX_UNION,
+  BLOX_INTERSECTION,
+  BLOX_DIFFERENCE,
+  BLOX_SYMMETRIC_DIFFERENCE
+};
+
+/*
+ Linear pass over two sorted containers producing a new one. Equal
+ elements are matched pairwise (so repeated values behave as multisets),
+ and whenever both sides are kept, those from `lhs` come first
+*/
+blox blox_combine_(const blox* lhs,
+                   const blox* rhs,
+                   size_t width,
+                   blox_comparison comparison,
+                   int operation) {
+  typedef unsigned char byte;
+  size_t bound = lhs->length;
+  if (operation == BLOX_INTERSECTION)
+    bound = lhs->length < rhs->length ? lhs->length : rhs->length;
+  else if (operation != BLOX_DIFFERENCE)
+    bound += rhs->length;
+  blox result = {0};
+  if (!blox_reserve_(&result, width, bound))
+    return result;
+  const byte* left = (const byte*)lhs->data;
+  const byte* left_end = left + lhs->length * width;
+  const byte* right = (const byte*)rhs->data;
+  const byte* right_end = right + rhs->length * width;
+  byte* target = (byte*)result.data;
+  int keep_left = operation != BLOX_INTERSECTION;
+  int keep_right = operation != BLOX_INTERSECTION &&
+                   operation != BLOX_DIFFERENCE;
+  while (left < left_end && right < right_end) {
+    int order = comparison(left, right);
+    if (order < 0 || (order == 0 && operation == BLOX_MERGE)) {
+      if (keep_left)
+        memcpy(target, left, width), target += width;
+      left += width;
+    } else if (order > 0) {
+      if (keep_right)
+        memcpy(target, right, width), target += width;
+      right += width;
+    } else {
+      if (operation == BLOX_UNION || operation == BLOX_INTERSECTION)
+        memcpy(target, left, width), target += width;
+      left += width;
+      right += width;
+    }
+  }
+  if (keep_left && left < left_end) {
+    memcpy(target, left, left_end - left);
+    target += left_end - left;
+  }
+  if (keep_right && right < right_end) {
+    memcpy(target, right, right_end - right);
+    target += right_end - right;
+  }
+  result.length = (target - (byte*)result.data) / width;
+  memset(target, 0, width);
+  BLOX__STAT(MOVED, result.length * width);
+  return result;
+}
+
+#define blox__combine(TYPE, lhs, rhs, comparison, operation) \
+  BLOX__SITED(blox_combine_(&(lhs), &(rhs), sizeof(TYPE),    \
+                            (blox_comparison)comparison, operation))
+
+#define blox_merge(TYPE, lhs, rhs, comparison) \
+  blox__combine(TYPE, lhs, rhs, comparison, BLOX_MERGE)
+
+#define blox_union(TYPE, lhs, rhs, comparison) \
+  blox__combine(TYPE, lhs, rhs, comparison, BLOX_UNION)
+
+#define blox_intersection(TYPE, lhs, rhs, comparison) \
+  blox__combine(TYPE, lhs, rhs, comparison, BLOX_INTERSECTION)
+
+#define blox_difference(TYPE, lhs, rhs, comparison) \
+  blox__combine(TYPE, lhs, rhs, comparison, BLOX_DIFFERENCE)
+
+#define blox_symmetric_difference(TYPE, lhs, rhs, comparison) \
+  blox__combine(TYPE, lhs, rhs, comparison, BLOX_SYMMETRIC_DIFFERENCE)
+
+/*
+ Heap order for the k-way merge: by the current element of each run, ties
+ going to the earlier run so that the merge is stable
+*/
+int blox_run_before_(const blox* runs,
+                     const size_t* cursors,
+                     size_t lhs,
+                     size_t rhs,
+                     size_t width,
+                     blox_comparison comparison) {
+  typedef unsigned char byte;
+  int order = comparison((const byte*)runs[lhs].data + cursors[lhs] * width,
+                         (const byte*)runs[rhs].data + cursors[rhs] * width);
+  return order < 0 || (order == 0 && lhs < rhs);
+}
+
+void blox_run_sift_(size_t* heap,
+                    size_t size,
+                    size_t root,
+                    const blox* runs,
+                    const size_t* cursors,
+                    size_t width,
+                    blox_comparison comparison) {
+  size_t run = heap[root];
+  size_t child;
+  while ((child = 2 * root + 1) < size) {
+    if (child + 1 < size && blox_run_before_(runs, cursors, heap[child + 1],
+                                             heap[child], width, comparison))
+      ++child;
+    if (!blox_run_before_(runs, cursors, heap[child], run, width, comparison))
+      break;
+    heap[root] = heap[child];
+    root = child;
+  }
+  heap[root] = run;
+}
+
+/*
+ Merges `count` sorted runs into a new container in a single pass, keeping
+ a binary heap of the runs ordered by their next element
+*/
+blox blox_merge_runs_(const blox* runs,
+                      size_t count,
+                      size_t width,
+                      blox_comparison comparison) {
+  typedef unsigned char byte;
+  blox result = {0};
+  if (count == 1)
+    return blox_combine_(&runs[0], &result, width, comparison, BLOX_MERGE);
+  if (count == 2)
+    return blox_combine_(&runs[0], &runs[1], width, comparison, BLOX_MERGE);
+  size_t total = 0;
+  for (size_t run = 0; run < count; ++run)
+    total += runs[run].length;
+  blox scratch = {0};
+  if (!blox_reserve_(&scratch, sizeof(size_t), 2 * count))
+    return result;
+  if (!blox_reserve_(&result, width, total)) {
+    blox_free(scratch);
+    return result;
+  }
+  size_t* cursors = blox_data(size_t, scratch);
+  size_t* heap = cursors + count;
+  size_t size = 0;
+  for (size_t run = 0; run < count; ++run) {
+    cursors[run] = 0;
+    if (runs[run].length != 0)
+      heap[size++] = run;
+  }
+  for (size_t root = size / 2; root--;)
+    blox_run_sift_(heap, size, root, runs, cursors, width, comparison);
+  byte* target = (byte*)result.data;
+  while (size != 0) {
+    size_t run = heap[0];
+    memcpy(target, (const byte*)runs[run].data + cursors[run] * width, width);
+    target += width;
+    if (++cursors[run] == runs[run].length)
+      heap[0] = heap[--size];
+    blox_run_sift_(heap, size, 0, runs, cursors, width, comparison);
+  }
+  memset(target, 0, width);
+  result.length = total;
+  BLOX__STAT(MOVED, total * width);
+  blox_free(scratch);
+  return result;
+}
+
+#define blox_merge_runs(TYPE, runs, comparison)                      \
+  BLOX__SITED(blox_merge_runs_(blox_data(blox, runs), (runs).length, \
+                               sizeof(TYPE), (blox_comparison)comparison))
+
+#endif  // BLOX_SORT_H_INCLUDED